@@ -0,0 +1,321 @@
+/* bench.c - per-stage timing of the analysis pipeline on synthetic signals
+ *
+ * Each frame runs the same steps as analyzeHop() in the tuner: filter one
+ * hop into the ring, window the ring, transform, find the peak bin and
+ * interpolate it to the nearest note and cents.  Every stage is timed
+ * separately for every frame, so the report can give percentiles as well
+ * as averages.  The filter4 stage filters the same hop on four
+ * interleaved channels at once, as the ensemble mode does; it is not part
+ * of the total.  With -d the
+ * filtered hop goes through the decimator (the decim stage) before the
+ * ring, and the FFT runs at the reduced rate.  The yin stage times the YIN
+ * detector on the same ring in place of window, fft, peak and note; it is
+ * not part of the total either, and nor are multi and bank, which do the
+ * same with the multi-resolution detector and the note bank over C2 to C6.
+ * The fixed stage runs filter to note in fixed point on the signal taken
+ * to 16 bits (without -d only), and every frame's note is held against
+ * the float pipeline's: the run fails if they are ever further apart than
+ * FIXED_CENTS_TOLERANCE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "libfft.h"
+#include "dsp.h"
+#include "yin.h"
+#include "multires.h"
+#include "notebank.h"
+#include "fixed.h"
+#include "tables.h"
+#include "signals.h"
+
+#define SAMPLE_RATE (8000)
+#define LOW_PASS_FILTER_PARAM (330)
+#define CENTS_SHARP_MULTIPLIER (1200)
+#define DEFAULT_HOP_SIZE (512)
+#define DEFAULT_FRAMES (1000)
+#define WARMUP_FRAMES (50)
+#define MIN_EXP_SIZE (10)
+#define MAX_EXP_SIZE (14)
+#define FIXED_CENTS_TOLERANCE (5.0) //most a frame in fixed point may differ from float: one bucket of the cents histogram
+
+enum { STAGE_FILTER, STAGE_DECIMATE, STAGE_WINDOW, STAGE_FFT, STAGE_PEAK, STAGE_NOTE, STAGE_TOTAL, STAGE_FILTER4,
+       STAGE_YIN, STAGE_MULTI, STAGE_BANK, STAGE_FIXED, NUM_STAGES };
+static const char * stageNames[NUM_STAGES] = { "filter", "decim", "window", "fft", "peak", "note", "total", "filter4",
+                                               "yin", "multi", "bank", "fixed" };
+
+static double nowNs(){
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compareDoubles( const void * a, const void * b ){
+   double x = *(const double *) a, y = *(const double *) b;
+   return x < y ? -1 : x > y;
+}
+
+//Filters count samples, stride apart, into ring at *ringPos, wrapping at size
+static void filterIntoRing( const float * in, int stride, int count, float ** rings, int numRings, int * ringPos,
+   int size, float ** mem1, float ** mem2, float * a, float * b ){
+   while( count > 0 ) {
+      int n = size - *ringPos;
+      if( n > count ) n = count;
+      if( numRings == 4 ) {
+         float * out[4];
+         for( int k=0; k<4; ++k )
+            out[k] = rings[k] + *ringPos;
+         processSecondOrderFilterBlock4( in, stride, out, n, mem1, mem2, a, b );
+      } else {
+         processSecondOrderFilterBlock( in, stride, rings[0] + *ringPos, n, mem1[0], mem2[0], a, b );
+      }
+      *ringPos = ( *ringPos + n ) % size;
+      in += (long) n * stride;
+      count -= n;
+   }
+}
+
+//Decimates count filtered samples into ring at *ringPos, wrapping at size
+static void decimateIntoRing( struct decimator * dec, const float * in, int count, float * ring, int * ringPos, int size ){
+   float out[DECIMATOR_BLOCK];
+   for( int i=0; i<count; i += DECIMATOR_BLOCK ) {
+      int n = decimate( dec, in + i, count - i < DECIMATOR_BLOCK ? count - i : DECIMATOR_BLOCK, out );
+      for( int j=0; j<n; ++j ) {
+         ring[*ringPos] = out[j];
+         if( ++*ringPos == size ) *ringPos = 0;
+      }
+   }
+}
+
+//Returns the p'th percentile of the sorted samples
+static double percentile( double * sorted, int count, double p ){
+   int i = (int)( p / 100 * ( count - 1 ) + .5 );
+   return sorted[i];
+}
+
+//Times frames hops of one signal through an FFT of 2**bits points at SAMPLE_RATE / decimation;
+//times[stage][frame] gets ns. Returns the furthest apart in cents the fixed and float notes of a frame were.
+static double runPipeline( int kind, int bits, int hop, int decimation, int frames, double ** times ){
+   int size = 1 << bits;
+   long count = (long) size * decimation + (long)( frames + WARMUP_FRAMES ) * hop;
+   float * input = malloc( count * sizeof( float ) );
+   float * ring = calloc( size, sizeof( float ) );
+   float * data = malloc( size * sizeof( float ) );
+   float * datai = malloc( ( size / 2 + 1 ) * sizeof( float ) );
+   float * input4 = malloc( count * 4 * sizeof( float ) );
+   float * rings4 = calloc( size * 4, sizeof( float ) );
+   float * filtered = malloc( ( size * decimation > hop ? size * decimation : hop ) * sizeof( float ) );
+   struct decimator * dec = malloc( sizeof( struct decimator ) );
+   int16_t * input16 = malloc( count * sizeof( int16_t ) );
+   int16_t * ring16 = calloc( size, sizeof( int16_t ) );
+   int32_t * fixedData = malloc( size * sizeof( int32_t ) );
+   int32_t * fixedDatai = malloc( ( size / 2 + 1 ) * sizeof( int32_t ) );
+   if( !input || !ring || !data || !datai || !input4 || !rings4 || !filtered || !dec
+      || !input16 || !ring16 || !fixedData || !fixedDatai ) {
+      fprintf( stderr, "Could not allocate for benchmark.\n" );
+      exit( 1 );
+   }
+   float a[2], b[3], mem1[4] = { 0 }, mem2[4] = { 0 }, mems4[8][4] = { { 0 } };
+   float * mem1p = mem1, * mem2p = mem2;
+   float * rings4p[4], * mem14p[4], * mem24p[4];
+   for( int k=0; k<4; ++k ) {
+      rings4p[k] = rings4 + k * size;
+      mem14p[k] = mems4[k];
+      mem24p[k] = mems4[k+4];
+   }
+   int ringPos = 0, ringPos4 = 0;
+   void * fft = initfft( bits );
+   const float * window = hanWindows[bits];
+   const int16_t * window16 = fixedHanWindows[bits];
+   computeSecondOrderLowPassParameters( SAMPLE_RATE, LOW_PASS_FILTER_PARAM, a, b );
+   initDecimator( dec, decimation );
+   float srate = (float) SAMPLE_RATE / decimation;
+   struct yin yin;
+   struct multiResolution multi;
+   struct noteBank bank;
+   struct fixedFilter fixedFilter;
+   struct fixedFft fixedFft;
+   if( initYin( &yin, srate ) || initMultiResolution( &multi, size, srate ) || initFixedFft( &fixedFft, size ) ) {
+      fprintf( stderr, "Could not allocate for benchmark.\n" );
+      exit( 1 );
+   }
+   //no note's window fits when the hop is most of the ring; bank is then left at 0
+   bool haveBank = !initNoteBank( &bank, srate, DEFAULT_LOW_NOTE, DEFAULT_HIGH_NOTE, size, hop / decimation );
+   generateSignal( kind, SAMPLE_RATE, input, count, 1 );
+   for( long j=0; j<count; ++j ) {
+      float v = roundf( input[j] * 32768 );
+      input16[j] = (int16_t)( v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v );
+   }
+   initFixedFilter( &fixedFilter, a, b );
+   for( long j=0; j<count; ++j )
+      for( int k=0; k<4; ++k )
+         input4[j*4+k] = input[j];
+
+   //fill the ring once so every timed frame sees a full window
+   if( decimation > 1 ) {
+      int filteredPos = 0;
+      filterIntoRing( input, 1, size * decimation, &filtered, 1, &filteredPos, size * decimation, &mem1p, &mem2p, a, b );
+      decimateIntoRing( dec, filtered, size * decimation, ring, &ringPos, size );
+   } else {
+      filterIntoRing( input, 1, size, &ring, 1, &ringPos, size, &mem1p, &mem2p, a, b );
+   }
+   filterIntoRing( input4, 4, size, rings4p, 4, &ringPos4, size, mem14p, mem24p, a, b );
+   processFixedFilterBlock( &fixedFilter, input16, 1, ring16, size );
+
+   long long total = size; //samples written to the ring, for the bank
+   volatile float sink = 0; //keeps the note lookup from being optimized away
+   float * in = input + (long) size * decimation, * in4 = input4 + size * 4;
+   int16_t * in16 = input16 + size;
+   int ringPos16 = 0;
+   double maxCents = 0;
+   for( int f=-WARMUP_FRAMES; f<frames; ++f, in += hop, in4 += hop * 4, in16 += hop ) {
+      double t0 = nowNs(), t1;
+      if( decimation > 1 ) {
+         int filteredPos = 0;
+         filterIntoRing( in, 1, hop, &filtered, 1, &filteredPos, hop, &mem1p, &mem2p, a, b );
+         t1 = nowNs();
+         decimateIntoRing( dec, filtered, hop, ring, &ringPos, size );
+      } else {
+         filterIntoRing( in, 1, hop, &ring, 1, &ringPos, size, &mem1p, &mem2p, a, b );
+         t1 = nowNs();
+      }
+      double t1d = nowNs();
+      applyWindow( window, ring, ringPos, data, size );
+      double t2 = nowNs();
+      applyrealfft( fft, data, data, datai );
+      double t3 = nowNs();
+      int maxIndex = findPeak( data, datai, size / 2 );
+      double t4 = nowNs();
+      float bin = maxIndex + interpolatePeak( data, datai, size / 2, maxIndex );
+      float midi = bin > 0 ? frequencyToMidi( bin * srate / size ) : 0;
+      int note = (int) floorf( midi + .5 );
+      float cents = CENTS_SHARP_MULTIPLIER / NUMNOTES * ( midi - note );
+      sink += cents + note % NUMNOTES;
+      double t5 = nowNs();
+      filterIntoRing( in4, 4, hop, rings4p, 4, &ringPos4, size, mem14p, mem24p, a, b );
+      double t6 = nowNs();
+      sink += yinPitch( &yin, ring, ringPos, size );
+      double t7 = nowNs();
+      float amplitude;
+      sink += multiResolutionPitch( &multi, ring, ringPos, size, data, datai, &amplitude, NULL );
+      double t8 = nowNs();
+      total += hop / decimation;
+      if( haveBank ) sink += noteBankPitch( &bank, ring, ringPos, size, total, &amplitude );
+      double t9 = nowNs();
+      if( decimation == 1 ) {
+         for( int left = hop; left > 0; ) {
+            int n = size - ringPos16 < left ? size - ringPos16 : left;
+            processFixedFilterBlock( &fixedFilter, in16 + hop - left, 1, ring16 + ringPos16, n );
+            ringPos16 = ( ringPos16 + n ) % size;
+            left -= n;
+         }
+         applyFixedWindow( window16, ring16, ringPos16, fixedData, size );
+         applyFixedRealFft( &fixedFft, fixedData, fixedData, fixedDatai );
+         int peak = findFixedPeak( fixedData, fixedDatai, size / 2 );
+         float re[3], im[3];
+         for( int k=0; k<3; ++k ) {
+            re[k] = fixedData[peak - 1 + k] * ( 1.0f / 2147483648.0f );
+            im[k] = fixedDatai[peak - 1 + k] * ( 1.0f / 2147483648.0f );
+         }
+         float fixedBin = peak + ( peak > 0 ? interpolatePeak( re, im, 3, 1 ) : 0 );
+         float fixedMidi = fixedBin > 0 ? frequencyToMidi( fixedBin * srate / size ) : 0;
+         int fixedNote = (int) floorf( fixedMidi + .5 );
+         sink += CENTS_SHARP_MULTIPLIER / NUMNOTES * ( fixedMidi - fixedNote ) + fixedNote % NUMNOTES;
+         double cents = fabs( CENTS_SHARP_MULTIPLIER / NUMNOTES * ( fixedMidi - midi ) );
+         if( f >= 0 && cents > maxCents ) maxCents = cents;
+      }
+      double t10 = nowNs();
+      if( f < 0 ) continue;
+      times[STAGE_FILTER][f] = t1 - t0;
+      times[STAGE_DECIMATE][f] = t1d - t1;
+      times[STAGE_WINDOW][f] = t2 - t1d;
+      times[STAGE_FFT][f] = t3 - t2;
+      times[STAGE_PEAK][f] = t4 - t3;
+      times[STAGE_NOTE][f] = t5 - t4;
+      times[STAGE_TOTAL][f] = t5 - t0;
+      times[STAGE_FILTER4][f] = t6 - t5;
+      times[STAGE_YIN][f] = t7 - t6;
+      times[STAGE_MULTI][f] = t8 - t7;
+      times[STAGE_BANK][f] = t9 - t8;
+      times[STAGE_FIXED][f] = t10 - t9;
+   }
+
+   destroyfft( fft );
+   destroyYin( &yin );
+   destroyMultiResolution( &multi );
+   if( haveBank ) destroyNoteBank( &bank );
+   free( input ); free( ring ); free( data ); free( datai );
+   free( input4 ); free( rings4 ); free( filtered ); free( dec );
+   free( input16 ); free( ring16 ); free( fixedData ); free( fixedDatai );
+   return maxCents;
+}
+
+static void usage( char * progName ){
+   fprintf( stderr, "Usage: %s [-c] [-H hop] [-d factor] [-n frames]\n", progName );
+   fprintf( stderr, "  -c         print CSV instead of a table\n" );
+   fprintf( stderr, "  -H hop     samples filtered per frame (default %d)\n", DEFAULT_HOP_SIZE );
+   fprintf( stderr, "  -d factor  decimate by 1, 2, 4 or 8 before the FFT (default 1)\n" );
+   fprintf( stderr, "  -n frames  timed frames per size and signal (default %d)\n", DEFAULT_FRAMES );
+}
+
+int main( int argc, char ** argv ){
+   int csv = 0, hop = DEFAULT_HOP_SIZE, decimation = 1, frames = DEFAULT_FRAMES;
+   int opt;
+   while( (opt = getopt( argc, argv, "cH:d:n:" )) != -1 ) {
+      switch( opt ) {
+      case 'c': csv = 1; break;
+      case 'H': hop = atoi( optarg ); break;
+      case 'd': decimation = atoi( optarg ); break;
+      case 'n': frames = atoi( optarg ); break;
+      default: usage( argv[0] ); return 1;
+      }
+   }
+   if( hop < 1 || frames < 1 || decimation < 1 || decimation > MAX_DECIMATION || hop % decimation ) {
+      usage( argv[0] );
+      return 1;
+   }
+
+   double * times[NUM_STAGES];
+   for( int s=0; s<NUM_STAGES; ++s ) {
+      times[s] = malloc( frames * sizeof( double ) );
+      if( !times[s] ) {
+         fprintf( stderr, "Could not allocate for benchmark.\n" );
+         return 1;
+      }
+   }
+
+   if( csv )
+      printf( "size,signal,stage,mean_ns,p50_ns,p90_ns,p99_ns,frames_per_s\n" );
+   else
+      printf( "%6s %-6s %-7s %10s %10s %10s %10s %12s\n",
+              "size", "signal", "stage", "mean ns", "p50 ns", "p90 ns", "p99 ns", "frames/s" );
+   double worstCents = 0;
+   for( int bits=MIN_EXP_SIZE; bits<=MAX_EXP_SIZE; ++bits ) {
+      for( int kind=0; kind<NUM_SIGNALS; ++kind ) {
+         double cents = runPipeline( kind, bits, hop, decimation, frames, times );
+         if( cents > worstCents ) worstCents = cents;
+         for( int s=0; s<NUM_STAGES; ++s ) {
+            double mean = 0;
+            for( int f=0; f<frames; ++f )
+               mean += times[s][f];
+            mean /= frames;
+            qsort( times[s], frames, sizeof( double ), compareDoubles );
+            printf( csv ? "%d,%s,%s,%.0f,%.0f,%.0f,%.0f,%.0f\n" : "%6d %-6s %-7s %10.0f %10.0f %10.0f %10.0f %12.0f\n",
+                    1 << bits, signalNames[kind], stageNames[s], mean,
+                    percentile( times[s], frames, 50 ), percentile( times[s], frames, 90 ),
+                    percentile( times[s], frames, 99 ), 1e9 / mean );
+         }
+      }
+   }
+
+   for( int s=0; s<NUM_STAGES; ++s )
+      free( times[s] );
+   if( decimation == 1 )
+      fprintf( stderr, "fixed point notes at most %.3f cents from float (tolerance %.1f)\n", worstCents,
+         FIXED_CENTS_TOLERANCE );
+   return worstCents > FIXED_CENTS_TOLERANCE;
+}
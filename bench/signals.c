@@ -0,0 +1,48 @@
+/* signals.c - synthetic test signals for the benchmarks */
+
+#include "signals.h"
+#include <math.h>
+
+#define TONE_PITCH (440.0)
+#define CHIRP_START (80.0)
+#define CHIRP_END (1000.0)
+#define VOICE_PITCH (220.0)
+#define VIBRATO_RATE (5.5)
+#define VIBRATO_CENTS (30.0)
+#define VOICE_HARMONICS (8)
+#define NOISE_LEVEL (0.1)
+
+const char * signalNames[NUM_SIGNALS] = { "tone", "chirp", "voice" };
+
+//Small linear congruential generator; returns uniform noise in [-1,1)
+static float noise( unsigned int * state ){
+   *state = *state * 1664525u + 1013904223u;
+   return ( *state >> 8 ) * ( 2.0f / 16777216.0f ) - 1.0f;
+}
+
+void generateSignal( int kind, float srate, float * out, long count, unsigned int seed ){
+   double phase = 0;
+   unsigned int state = seed;
+   for( long i=0; i<count; ++i ) {
+      double t = i / (double) srate;
+      double f;
+      switch( kind ) {
+      case SIGNAL_TONE:
+         out[i] = 0.5 * sin( 2 * M_PI * TONE_PITCH * t );
+         break;
+      case SIGNAL_CHIRP: //exponential sweep across the whole signal
+         f = CHIRP_START * pow( CHIRP_END / CHIRP_START, i / (double) count );
+         phase += 2 * M_PI * f / srate;
+         out[i] = 0.5 * sin( phase );
+         break;
+      default: //harmonic-rich tone with vibrato and breath noise
+         f = VOICE_PITCH * pow( 2, VIBRATO_CENTS / 1200 * sin( 2 * M_PI * VIBRATO_RATE * t ) );
+         phase += 2 * M_PI * f / srate;
+         out[i] = 0;
+         for( int h=1; h<=VOICE_HARMONICS; ++h )
+            out[i] += 0.3 * sin( h * phase ) / h;
+         out[i] += NOISE_LEVEL * noise( &state );
+         break;
+      }
+   }
+}
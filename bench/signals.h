@@ -0,0 +1,14 @@
+/* signals.h - synthetic test signals for the benchmarks */
+
+#ifndef SIGNALS_H
+#define SIGNALS_H
+
+enum { SIGNAL_TONE, SIGNAL_CHIRP, SIGNAL_VOICE, NUM_SIGNALS };
+
+extern const char * signalNames[NUM_SIGNALS];
+
+//Fills out with count samples of the given kind of signal at srate. The same seed always gives
+//the same samples, so runs on different commits see identical input.
+void generateSignal( int kind, float srate, float * out, long count, unsigned int seed );
+
+#endif
@@ -0,0 +1,415 @@
+/* analysis.c - per-channel pitch analysis and scoring
+ *
+ * Copyright (C) 2012 by Bjorn Roche
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose and without fee is hereby granted, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  This software is provided "as is" without express or
+ * implied warranty.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dsp.h"
+#include "analysis.h"
+
+int checkAnalysisOptions(struct analysisOptions * options){
+   if( options->fftSize == 0 ) {
+      options->fftSize = MIN_FFT_SIZE;
+      while( options->fftSize < options->sampleRate && options->fftSize < MAX_FFT_SIZE )
+         options->fftSize *= 2;
+   }
+   if( options->fftSize < MIN_FFT_SIZE || options->fftSize > MAX_FFT_SIZE
+      || ( options->fftSize & ( options->fftSize - 1 ) ) )
+      return DINO_PITCH_BAD_WINDOW;
+   if( options->hop == 0 )
+      options->hop = options->fftSize / DEFAULT_HOPS_PER_WINDOW;
+   if( options->hop < 1 || options->hop > options->fftSize ) return DINO_PITCH_BAD_HOP;
+   if( options->hop % options->decimation ) return DINO_PITCH_BAD_HOP_DECIMATION;
+   if( options->fixedPoint && ( options->detector != &fftDetector || options->decimation > 1 ) )
+      return DINO_PITCH_BAD_FIXED_POINT;
+   return DINO_PITCH_OK;
+}
+
+int analysisOptionsFrom(const struct dinoPitchOptions * options, struct analysisOptions * out){
+   const struct pitchDetector * detector = findDetector( options->detector );
+   if( !detector ) return DINO_PITCH_BAD_DETECTOR;
+   if( options->sampleRate <= 0 ) return DINO_PITCH_BAD_RATE;
+   if( options->decimation < 1 || options->decimation > MAX_DECIMATION
+      || ( options->decimation & ( options->decimation - 1 ) ) )
+      return DINO_PITCH_BAD_DECIMATION;
+   if( options->lowNote > options->highNote ) return DINO_PITCH_BAD_NOTE_RANGE;
+   *out = (struct analysisOptions) {
+      .sampleRate = options->sampleRate, .fftSize = options->windowSize, .hop = options->hop,
+      .decimation = options->decimation, .detector = detector, .lowNote = options->lowNote,
+      .highNote = options->highNote, .noiseFloor = options->noiseFloor, .melody = options->melody,
+      .fixedPoint = options->fixedPoint
+   };
+   return checkAnalysisOptions(out);
+}
+
+int createAnalyses(int numChannels, const struct analysisOptions * options, struct analysis ** ans){
+   *ans = malloc(numChannels * sizeof(struct analysis));
+   if( !*ans ) return DINO_PITCH_NO_MEMORY;
+   for( int c = 0; c < numChannels; ++c ) {
+      int error = initAnalysis(&(*ans)[c], options);
+      if( error ) {
+         destroyAnalyses(*ans, c);
+         *ans = NULL;
+         return error;
+      }
+      (*ans)[c].channel = c;
+   }
+   return DINO_PITCH_OK;
+}
+
+void destroyAnalyses(struct analysis * ans, int numChannels){
+   if( !ans ) return;
+   for( int c = 0; c < numChannels; ++c )
+      destroyAnalysis( &ans[c] );
+   free( ans );
+}
+
+//Returns size bytes starting on a cache line, to be freed with free(), or NULL
+static void * allocBuffer(size_t size){
+   void * p;
+   return posix_memalign(&p, BUFFER_ALIGNMENT, size) ? NULL : p;
+}
+
+static void freeBuffers(struct analysis * an){
+   free( an->input );
+   free( an->ring );
+   free( an->data );
+   free( an->datai );
+   free( an->input16 );
+   free( an->ring16 );
+   free( an->fixedData );
+   free( an->fixedDatai );
+}
+
+void destroyAnalysis(struct analysis * an){
+   an->detector->destroy( an );
+   destroyOnsetDetector( &an->onset );
+   if( an->following ) destroyMelodyFollower( &an->follower );
+   destroyScoreCard( &an->card );
+   freeBuffers( an );
+}
+
+//Sets up the filter and pitch detector, and clears the running totals. options must have passed
+//checkAnalysisOptions(). Above 1, the decimation (a power of two, dividing the hop) runs the analysis at
+//sampleRate / decimation with a ring that much smaller. Returns DINO_PITCH_OK, or why it could not be set up.
+int initAnalysis(struct analysis * an, const struct analysisOptions * options){
+   an->hop = options->hop;
+   an->decimation = options->decimation;
+   an->inputRate = options->sampleRate;
+   an->fftSize = options->fftSize / options->decimation;
+   an->sampleRate = (float) options->sampleRate / options->decimation;
+   an->fixedPoint = options->fixedPoint;
+   an->detector = an->fixedPoint ? &fixedDetector : options->detector;
+   an->lowNote = options->lowNote;
+   an->highNote = options->highNote;
+   an->channel = 0;
+   an->log = NULL;
+   an->logStart = 0;
+   an->frames = NULL;
+   an->numFrames = an->maxFrames = 0;
+   an->input = an->ring = an->data = an->datai = NULL;
+   an->input16 = an->ring16 = NULL;
+   an->window = NULL; //the fft detector points these at a shared window
+   an->window16 = NULL;
+   an->fixedData = an->fixedDatai = NULL;
+   bool allocated;
+   if( an->fixedPoint ) {
+      an->input16 = allocBuffer( an->hop * sizeof( int16_t ) );
+      an->ring16 = allocBuffer( an->fftSize * sizeof( int16_t ) );
+      an->fixedData = allocBuffer( an->fftSize * sizeof( int32_t ) );
+      an->fixedDatai = allocBuffer( ( an->fftSize / 2 + 1 ) * sizeof( int32_t ) );
+      allocated = an->input16 && an->ring16 && an->fixedData && an->fixedDatai;
+   } else {
+      an->input = allocBuffer( an->hop * sizeof( float ) );
+      an->ring = allocBuffer( an->fftSize * sizeof( float ) );
+      an->data = allocBuffer( an->fftSize * sizeof( float ) );
+      an->datai = allocBuffer( ( an->fftSize / 2 + 1 ) * sizeof( float ) );
+      allocated = an->input && an->ring && an->data && an->datai;
+   }
+   if( !allocated ) {
+      freeBuffers( an );
+      return DINO_PITCH_NO_MEMORY;
+   }
+   computeSecondOrderLowPassParameters( options->sampleRate, LOW_PASS_FILTER_PARAM, an->a, an->b );
+   initDecimator( &an->decimator, options->decimation );
+   initFixedFilter( &an->fixedFilter, an->a, an->b );
+   if( an->detector->init(an) ) {
+      freeBuffers( an );
+      return DINO_PITCH_DETECTOR_FAILED;
+   }
+   if( initOnsetDetector( &an->onset, an->sampleRate, an->fftSize, options->noiseFloor ) ) {
+      an->detector->destroy( an );
+      freeBuffers( an );
+      return DINO_PITCH_NO_MEMORY;
+   }
+   an->following = options->melody != NULL;
+   if( an->following && initMelodyFollower( &an->follower, options->melody, (double) an->hop / an->inputRate ) ) {
+      destroyOnsetDetector( &an->onset );
+      an->detector->destroy( an );
+      freeBuffers( an );
+      return DINO_PITCH_NO_MEMORY;
+   }
+   initScoreCard(&an->card);
+   clearMetrics(&an->metrics);
+   resetAnalysis(an);
+   return DINO_PITCH_OK;
+}
+
+//Forgets all input and clears the running totals, keeping the tables and FFT plan for the next recording
+void resetAnalysis(struct analysis * an){
+   for( int i=0; i<4; ++i ) {
+      an->mem1[i] = 0;
+      an->mem2[i] = 0;
+   }
+   resetDecimator( &an->decimator );
+   resetFixedFilter( &an->fixedFilter );
+   if( an->fixedPoint )
+      memset( an->ring16, 0, an->fftSize * sizeof( int16_t ) );
+   else
+      memset( an->ring, 0, an->fftSize * sizeof( float ) );
+   an->ringPos = 0;
+   an->samplesSeen = 0;
+   an->samplesWindowed = 0;
+   an->samplesIn = 0;
+   an->energy = 0;
+   an->energySamples = 0;
+   an->silentHops = 0;
+   an->onsetPending = false;
+   resetOnsetDetector( &an->onset );
+   if( an->detector == &bankDetector ) resetNoteBank( &an->bank );
+   initNoteTracker(&an->notes);
+   if( an->following ) resetMelodyFollower( &an->follower );
+   clearScoreCard(&an->card);
+}
+
+//Scores the notes still being sung when the input ends
+void finishAnalyses(struct analysis * ans, int numChannels){
+   for( int c = 0; c < numChannels; ++c )
+      finishNote(&ans[c].card, &ans[c].notes);
+}
+
+//Has every frame ans score from now on written to log as well, dated from start, the time of the first
+//sample they are given
+void logAnalyses(struct analysis * ans, int numChannels, struct frameLog * log, int64_t start){
+   for( int c = 0; c < numChannels; ++c ) {
+      ans[c].log = log;
+      ans[c].logStart = start;
+   }
+}
+
+//Adds count filtered samples to the ring
+static void pushRing(struct analysis * an, const float * x, int count){
+   if( an->samplesSeen < an->fftSize )
+      an->samplesSeen += count;
+   while( count > 0 ) {
+      int n = an->fftSize - an->ringPos; //up to the end of the ring
+      if( n > count ) n = count;
+      memcpy( an->ring + an->ringPos, x, n * sizeof( float ) );
+      an->ringPos = ( an->ringPos + n ) % an->fftSize;
+      x += n;
+      count -= n;
+   }
+}
+
+//Adds up the power of count raw samples, for the noise gate
+static void addEnergy(struct analysis * an, const float * input, int count, int stride){
+   float sum = 0;
+   for( int i = 0; i < count; ++i )
+      sum += input[(long) i * stride] * input[(long) i * stride];
+   an->energy += sum;
+   an->energySamples += count;
+}
+
+//Filters count samples, each stride apart in input, into the ring. Interleaved channels are read in
+//place this way instead of being copied apart first.
+void filterInput(struct analysis * an, const float * input, int count, int stride){
+   an->samplesIn += count;
+   addEnergy( an, input, count, stride );
+   if( an->decimation > 1 ) {
+      float filtered[DECIMATOR_BLOCK], decimated[DECIMATOR_BLOCK];
+      while( count > 0 ) {
+         int n = count < DECIMATOR_BLOCK ? count : DECIMATOR_BLOCK;
+         processSecondOrderFilterBlock( input, stride, filtered, n, an->mem1, an->mem2, an->a, an->b );
+         pushRing(an, decimated, decimate( &an->decimator, filtered, n, decimated ));
+         input += (long) n * stride;
+         count -= n;
+      }
+      return;
+   }
+   if( an->samplesSeen < an->fftSize )
+      an->samplesSeen += count;
+   while( count > 0 ) {
+      int n = an->fftSize - an->ringPos; //up to the end of the ring
+      if( n > count ) n = count;
+      if( an->hop == an->fftSize && an->detector == &fftDetector ) {
+         //the windows don't overlap, so each sample is windowed once, as it is filtered
+         processSecondOrderFilterWindowBlock( input, stride, an->ring + an->ringPos, an->data + an->ringPos,
+            an->window + an->ringPos, n, an->mem1, an->mem2, an->a, an->b );
+         an->samplesWindowed += n;
+      } else {
+         processSecondOrderFilterBlock( input, stride, an->ring + an->ringPos, n, an->mem1, an->mem2, an->a, an->b );
+      }
+      an->ringPos = ( an->ringPos + n ) % an->fftSize;
+      input += (long) n * stride;
+      count -= n;
+   }
+}
+
+//filterInput() for 16 bit input, into the ring of a fixed point analysis
+void filterInputFixed(struct analysis * an, const int16_t * input, int count, int stride){
+   int64_t sum = 0;
+   for( int i = 0; i < count; ++i )
+      sum += (int32_t) input[(long) i * stride] * input[(long) i * stride];
+   an->energy += sum * ( 1.0 / ( 32768.0 * 32768.0 ) );
+   an->energySamples += count;
+   an->samplesIn += count;
+   if( an->samplesSeen < an->fftSize )
+      an->samplesSeen += count;
+   while( count > 0 ) {
+      int n = an->fftSize - an->ringPos; //up to the end of the ring
+      if( n > count ) n = count;
+      processFixedFilterBlock( &an->fixedFilter, input, stride, an->ring16 + an->ringPos, n );
+      an->ringPos = ( an->ringPos + n ) % an->fftSize;
+      input += (long) n * stride;
+      count -= n;
+   }
+}
+
+//Filters numChannels adjacent channels of interleaved input into ans[0..numChannels). Channels that
+//are in step go through four at a time.
+void filterInputs(struct analysis * ans, int numChannels, const float * input, int count, int stride){
+   int c = 0;
+   for( ; c + 4 <= numChannels; c += 4 ) {
+      struct analysis * an = &ans[c];
+      if( an->decimation > 1 || ( an->hop == an->fftSize && an->detector == &fftDetector )
+         || an[1].ringPos != an->ringPos || an[2].ringPos != an->ringPos || an[3].ringPos != an->ringPos )
+         break;
+      const float * in = input + c;
+      int left = count;
+      while( left > 0 ) {
+         int n = an->fftSize - an->ringPos;
+         if( n > left ) n = left;
+         float * out[4], * mem1[4], * mem2[4];
+         for( int k = 0; k < 4; ++k ) {
+            out[k] = an[k].ring + an[k].ringPos;
+            mem1[k] = an[k].mem1;
+            mem2[k] = an[k].mem2;
+         }
+         processSecondOrderFilterBlock4( in, stride, out, n, mem1, mem2, an->a, an->b );
+         for( int k = 0; k < 4; ++k )
+            an[k].ringPos = ( an[k].ringPos + n ) % an->fftSize;
+         in += (long) n * stride;
+         left -= n;
+      }
+      for( int k = 0; k < 4; ++k ) {
+         if( an[k].samplesSeen < an->fftSize )
+            an[k].samplesSeen += count;
+         an[k].samplesIn += count;
+         addEnergy( &an[k], input + c + k, count, stride );
+      }
+   }
+   for( ; c < numChannels; ++c )
+      filterInput(&ans[c], input + c, count, stride);
+}
+
+//Lines a hop up with the melody, if there is one. A hop sung with no melody, or during one of its notes,
+//is scored against the note in score and returns true; one sung in a rest returns false.
+static bool followHop(struct analysis * an, float midi, bool sounding, int * scoredNote, float * scoredCents){
+   if( !an->following ) return sounding;
+   uint64_t start = monotonicNanos();
+   int target = followMelody(&an->follower, midi, sounding);
+   recordStage(&an->metrics, STAGE_ALIGN, start);
+   if( !sounding || target == MELODY_REST ) return false;
+   //a wrong note is as far off as scoring goes, and no further
+   float cents = CENTS_SHARP_MULTIPLIER / NUMNOTES * ( midi - target );
+   *scoredNote = target;
+   *scoredCents = cents < -SCORETOTAL ? -SCORETOTAL : cents > SCORETOTAL ? SCORETOTAL : cents;
+   return true;
+}
+
+//Fills in the record of a frame scored as note, cents sharp of it
+static void makeRecord(const struct analysis * an, struct frameRecord * record, int64_t time, int note, float cents,
+   bool started){
+   record->time = time;
+   record->centsSharp = cents;
+   record->level = frameLevel( an->amplitude );
+   //notes out of this range aren't scored either way, so they can be pinned to it
+   record->midiNote = note < 0 ? 0 : note > UINT8_MAX ? UINT8_MAX : note;
+   record->channel = an->channel | ( started ? FRAME_LOG_ONSET : 0 );
+}
+
+//Called after each hop has gone through filterInput(). Once the ring holds a full frame and the hop is
+//louder than the noise floor, finds the nearest note and scores it, against the note the melody has got
+//to if there is one. Returns false if there was not yet enough input, the hop was too quiet or the frame
+//has no pitch.
+bool analyzeHop(struct analysis * an, char ** nearestNoteNamep, float * centsSharpp){
+   float meanSquare = an->energySamples ? an->energy / an->energySamples : 0;
+   an->energy = 0;
+   an->energySamples = 0;
+   if( an->samplesSeen < an->frameSize ) return false;
+   uint64_t start = monotonicNanos();
+   int onset = an->fixedPoint
+      ? detectOnsetFixed(&an->onset, meanSquare, an->ring16, an->ringPos, an->fftSize, an->hop)
+      : detectOnset(&an->onset, meanSquare, an->ring, an->ringPos, an->fftSize, an->hop / an->decimation);
+   recordStage(&an->metrics, STAGE_ONSET, start);
+   if( onset == ONSET_SILENT ) {
+      an->silentHops++;
+      followHop(an, 0, false, NULL, NULL);
+      return false;
+   }
+   bool started = onset == ONSET_START || an->onsetPending;
+   float freq = an->detector->detect(an);
+   an->onsetPending = freq <= 0 && started;
+   if( freq <= 0 ) {
+      followHop(an, 0, false, NULL, NULL);
+      return false;
+   }
+
+   an->frequency = freq;
+   an->started = started;
+   an->scored = false;
+
+   //find the nearest note in closed form
+   float midi = frequencyToMidi( freq );
+   int nearestNote = (int) floorf( midi + .5 );
+   float centsSharp = CENTS_SHARP_MULTIPLIER / NUMNOTES * ( midi - nearestNote );
+   *nearestNoteNamep = NOTES[( nearestNote % NUMNOTES + NUMNOTES ) % NUMNOTES];
+   *centsSharpp = centsSharp;
+   int scoredNote = nearestNote;
+   float scoredCents = centsSharp;
+   if( !followHop(an, midi, true, &scoredNote, &scoredCents) ) return true;
+   an->scored = true;
+   an->scoredNote = scoredNote;
+   an->scoredCents = scoredCents;
+
+   start = monotonicNanos();
+   int64_t time = an->logStart + an->samplesIn * 1000000 / an->inputRate;
+   if( an->frames ) { //the caller scores them, in order with frames it got elsewhere
+      if( an->numFrames < an->maxFrames )
+         makeRecord(an, &an->frames[an->numFrames++], time, scoredNote, scoredCents, started);
+      recordStage(&an->metrics, STAGE_SCORE, start);
+      return true;
+   }
+   an->card.numInputs++;
+   updateInfo(&an->card, scoredNote, scoredCents);
+   trackNote(&an->card, &an->notes, time, scoredNote, scoredCents, started);
+   if( an->log ) {
+      struct frameRecord record;
+      makeRecord(an, &record, time, scoredNote, scoredCents, started);
+      if( an->card.numInputs == 1 ) record.channel |= FRAME_LOG_FIRST;
+      logFrame(an->log, &record);
+   }
+   recordStage(&an->metrics, STAGE_SCORE, start);
+   return true;
+}
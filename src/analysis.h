@@ -0,0 +1,133 @@
+/* analysis.h - per-channel pitch analysis and scoring
+ *
+ * Copyright (C) 2012 by Bjorn Roche
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose and without fee is hereby granted, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  This software is provided "as is" without express or
+ * implied warranty.
+ *
+ */
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dsp.h"
+#include "stats.h"
+#include "yin.h"
+#include "multires.h"
+#include "notebank.h"
+#include "fixed.h"
+#include "onset.h"
+#include "melody.h"
+#include "detector.h"
+#include "framelog.h"
+#include "metrics.h"
+#include "dinopitch.h"
+
+/* -- some basic parameters -- */
+#define DEFAULT_SAMPLE_RATE (8000)
+#define MIN_FFT_SIZE (DINO_PITCH_MIN_WINDOW)
+#define MAX_FFT_SIZE (DINO_PITCH_MAX_WINDOW)
+#define DEFAULT_HOPS_PER_WINDOW (DINO_PITCH_HOPS_PER_WINDOW) //512 samples at 8000 Hz
+#define LOW_PASS_FILTER_PARAM (330)
+#define CENTS_SHARP_MULTIPLIER (1200)
+#define BUFFER_ALIGNMENT (64) //a cache line, so no two channels' buffers share one
+
+/* -- how every channel is analyzed; set from the command line -- */
+struct analysisOptions {
+   int sampleRate; //of the input, in Hz
+   int fftSize; //input samples the analysis window spans, a power of two; 0 for about a second
+   int hop; //input samples between pitch estimates; 0 for DEFAULT_HOPS_PER_WINDOW a window
+   int decimation; //1, or the factor the filtered input is decimated by before analysis
+   const struct pitchDetector * detector;
+   int lowNote, highNote; //MIDI notes the bank detector listens for
+   float noiseFloor; //dB relative to a full scale sine; quieter hops are not analyzed
+   const struct melody * melody; //NULL, or what the singer is meant to sing
+   bool fixedPoint; //16 bit input through fft's pipeline in fixed point; needs fft and no decimation
+};
+
+/* -- state the analysis pipeline carries from one hop to the next; one per channel -- */
+struct analysis {
+   int hop; //in input samples
+   int decimation; //the ring keeps one filtered sample in decimation
+   int inputRate; //of the input, in Hz
+   int fftSize; //the window in ring samples: options fftSize / decimation, so it spans the same time and
+                //the bins are as narrow
+   const struct pitchDetector * detector;
+   int channel; //of the input, for the frame log
+   int frameSize; //newest samples in ring the detector looks at
+   float a[2], b[3], mem1[4], mem2[4];
+   struct decimator decimator;
+   float * input; //raw samples for the next hop
+   float * ring; //last fftSize filtered samples
+   int ringPos; //index of the oldest sample in ring
+   int samplesSeen; //counts up to fftSize so we don't analyze a partly empty frame
+   long long samplesIn; //input samples filtered since the last reset, which dates each frame
+   double energy; //sum of squares of the raw input since the last analyzeHop()
+   int energySamples;
+   float sampleRate; //of the samples in ring
+   //fft detector
+   int samplesWindowed; //samples filtered straight into data since the last analyzeHop(), when hop == fftSize
+   const float * window; //fftSize long, from hanWindows
+   float * data, * datai; //fftSize and fftSize/2+1 long
+   void * fft;
+   //yin detector
+   struct yin yin;
+   //multi detector
+   struct multiResolution multi;
+   //bank detector
+   int lowNote, highNote;
+   struct noteBank bank;
+   //fixed point, in place of the float filter, ring and fft detector
+   bool fixedPoint;
+   struct fixedFilter fixedFilter;
+   int16_t * input16, * ring16; //hop and fftSize long; input and ring are NULL
+   const int16_t * window16; //fftSize long, from fixedHanWindows
+   int32_t * fixedData, * fixedDatai; //fftSize and fftSize/2+1 long; data and datai are NULL
+   struct fixedFft fixedFft;
+   float amplitude; //of the last pitch found, 1 for a full scale sine; set by the detector
+   float frequency; //of the last pitch found, in Hz
+   bool started; //a note started with the last pitch found
+   bool scored; //the last pitch found was scored, as scoredNote and scoredCents; not in a rest of the melody
+   int scoredNote;
+   float scoredCents;
+   struct onsetDetector onset;
+   long long silentHops; //hops the gate kept from the detector
+   bool onsetPending; //an onset came on a hop with no pitch, so it goes with the next pitch found
+   struct noteTracker notes;
+   bool following; //scoring against the melody, not the nearest note
+   struct melodyFollower follower;
+   struct scoreCard card;
+   struct frameLog * log; //NULL, or where every scored frame is also written
+   struct frameRecord * frames; //NULL, or where scored frames go instead of card and notes, maxFrames at most,
+                                //for the caller to score in order with others (see scoreFrames())
+   int numFrames, maxFrames;
+   int64_t logStart; //microseconds since the Unix epoch of the first input sample
+   struct metrics metrics; //how long each stage took, for this channel and whatever its thread times with it
+};
+
+//Fills in the window and hop left at 0 for options' sample rate and checks they fit together.
+//Returns DINO_PITCH_OK if they do, or what is wrong.
+int checkAnalysisOptions(struct analysisOptions * options);
+//Sets out from the library's options, and checks them as checkAnalysisOptions() does. Returns DINO_PITCH_OK
+//if they can be used, or what is wrong.
+int analysisOptionsFrom(const struct dinoPitchOptions * options, struct analysisOptions * out);
+//Sets *ans to one analysis per channel. Returns DINO_PITCH_OK, or why they could not be set up.
+int createAnalyses(int numChannels, const struct analysisOptions * options, struct analysis ** ans);
+void destroyAnalyses(struct analysis * ans, int numChannels);
+int initAnalysis(struct analysis * an, const struct analysisOptions * options);
+void destroyAnalysis(struct analysis * an);
+void resetAnalysis(struct analysis * an);
+void finishAnalyses(struct analysis * ans, int numChannels);
+void logAnalyses(struct analysis * ans, int numChannels, struct frameLog * log, int64_t start);
+void filterInput(struct analysis * an, const float * input, int count, int stride);
+void filterInputs(struct analysis * ans, int numChannels, const float * input, int count, int stride);
+void filterInputFixed(struct analysis * an, const int16_t * input, int count, int stride);
+bool analyzeHop(struct analysis * an, char ** nearestNoteNamep, float * centsSharpp);
+
+#endif
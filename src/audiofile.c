@@ -0,0 +1,145 @@
+/* audiofile.c - memory-mapped WAV and raw PCM input */
+
+#include "audiofile.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WAVE_FORMAT_PCM (1)
+#define WAVE_FORMAT_IEEE_FLOAT (3)
+#define WAVE_FORMAT_EXTENSIBLE (0xFFFE)
+
+//Reads little-endian integers out of the file header
+static unsigned int le16( const unsigned char * p ) { return p[0] | ( p[1] << 8 ); }
+static unsigned long le32( const unsigned char * p ) {
+   return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (unsigned long) p[3] << 24 );
+}
+
+//Walks the RIFF chunks for "fmt " and "data". Returns 0 on success.
+static int parseWav( const char * path, struct audioFile * af ){
+   const unsigned char * p = af->map;
+   const unsigned char * end = p + af->mapSize;
+   const unsigned char * fmt = NULL;
+   unsigned long fmtLen = 0;
+   p += 12;
+   while( p + 8 <= end ) {
+      unsigned long len = le32( p + 4 );
+      const unsigned char * body = p + 8;
+      if( len > (unsigned long)( end - body ) ) len = end - body; //truncated recording; use what is there
+      if( !memcmp( p, "fmt ", 4 ) && len >= 16 ) {
+         fmt = body;
+         fmtLen = len;
+      } else if( !memcmp( p, "data", 4 ) && fmt ) {
+         unsigned int tag = le16( fmt );
+         unsigned int bits = le16( fmt + 14 );
+         af->channels = le16( fmt + 2 );
+         af->sampleRate = le32( fmt + 4 );
+         if( tag == WAVE_FORMAT_EXTENSIBLE && fmtLen >= 40 ) tag = le16( fmt + 24 );
+         if( tag == WAVE_FORMAT_PCM && bits == 16 ) {
+            af->format = AUDIO_INT16;
+         } else if( tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32 ) {
+            af->format = AUDIO_FLOAT32;
+         } else {
+            fprintf( stderr, "%s: only 16 bit PCM and 32 bit float WAV files are supported\n", path );
+            return 1;
+         }
+         if( af->channels < 1 ) break;
+         af->samples = (const char *) body;
+         af->frames = len / ( af->channels * ( bits / 8 ) );
+         return 0;
+      }
+      p = body + len + ( len & 1 ); //chunks are padded to an even length
+   }
+   fprintf( stderr, "%s: not a valid WAV file\n", path );
+   return 1;
+}
+
+int openAudioFile( const char * path, int rawFormat, struct audioFile * af ){
+   struct stat st;
+   memset( af, 0, sizeof( *af ) );
+   int fd = open( path, O_RDONLY );
+   if( fd < 0 || fstat( fd, &st ) ) {
+      perror( path );
+      if( fd >= 0 ) close( fd );
+      return 1;
+   }
+   if( st.st_size == 0 ) {
+      fprintf( stderr, "%s: empty file\n", path );
+      close( fd );
+      return 1;
+   }
+   af->mapSize = st.st_size;
+   af->map = mmap( NULL, af->mapSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd ); //the mapping keeps the file open
+   if( af->map == MAP_FAILED ) {
+      perror( path );
+      af->map = NULL;
+      return 1;
+   }
+   posix_madvise( af->map, af->mapSize, POSIX_MADV_SEQUENTIAL );
+
+   const char * head = af->map;
+   if( af->mapSize >= 12 && !memcmp( head, "RIFF", 4 ) && !memcmp( head + 8, "WAVE", 4 ) ) {
+      if( parseWav( path, af ) ) {
+         closeAudioFile( af );
+         return 1;
+      }
+      return 0;
+   }
+   af->samples = head;
+   af->channels = 1;
+   af->format = rawFormat;
+   af->frames = af->mapSize / ( rawFormat == AUDIO_INT16 ? sizeof( int16_t ) : sizeof( float ) );
+   return 0;
+}
+
+void closeAudioFile( struct audioFile * af ){
+   if( af->map ) munmap( af->map, af->mapSize );
+   af->map = NULL;
+}
+
+//Samples are little-endian in both WAV and our raw files, the same as every host we build on,
+//so they are copied out directly.
+size_t readAudioFile( const struct audioFile * af, size_t frame, int channel, float * out, size_t count ){
+   if( frame >= af->frames ) return 0;
+   if( count > af->frames - frame ) count = af->frames - frame;
+   if( af->format == AUDIO_INT16 ) {
+      const char * p = af->samples + ( frame * af->channels + channel ) * sizeof( int16_t );
+      for( size_t i = 0; i < count; ++i, p += af->channels * sizeof( int16_t ) ) {
+         int16_t v;
+         memcpy( &v, p, sizeof( v ) );
+         out[i] = v * ( 1.0f / 32768 );
+      }
+   } else {
+      const char * p = af->samples + ( frame * af->channels + channel ) * sizeof( float );
+      for( size_t i = 0; i < count; ++i, p += af->channels * sizeof( float ) )
+         memcpy( &out[i], p, sizeof( float ) );
+   }
+   return count;
+}
+
+size_t readAudioFile16( const struct audioFile * af, size_t frame, int channel, int16_t * out, size_t count ){
+   if( frame >= af->frames ) return 0;
+   if( count > af->frames - frame ) count = af->frames - frame;
+   if( af->format == AUDIO_INT16 ) {
+      const char * p = af->samples + ( frame * af->channels + channel ) * sizeof( int16_t );
+      for( size_t i = 0; i < count; ++i, p += af->channels * sizeof( int16_t ) )
+         memcpy( &out[i], p, sizeof( int16_t ) );
+   } else {
+      const char * p = af->samples + ( frame * af->channels + channel ) * sizeof( float );
+      for( size_t i = 0; i < count; ++i, p += af->channels * sizeof( float ) ) {
+         float v;
+         memcpy( &v, p, sizeof( v ) );
+         //a NaN has no 16 bit value, and anything past full scale is clipped before it is converted
+         if( isnan( v ) ) v = 0;
+         v = roundf( v * 32768 );
+         out[i] = (int16_t)( v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v );
+      }
+   }
+   return count;
+}
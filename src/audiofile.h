@@ -0,0 +1,32 @@
+/* audiofile.h - memory-mapped WAV and raw PCM input */
+
+#ifndef AUDIOFILE_H
+#define AUDIOFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* sample formats understood in a file */
+enum { AUDIO_INT16, AUDIO_FLOAT32 };
+
+struct audioFile {
+   void * map;            //the whole file, mapped read-only
+   size_t mapSize;
+   const char * samples;  //first sample frame
+   size_t frames;         //number of sample frames
+   int channels;
+   int format;            //AUDIO_INT16 or AUDIO_FLOAT32
+   int sampleRate;        //0 if the file does not say (raw PCM)
+};
+
+//Maps path and finds its samples. WAV files describe themselves; anything else is read as mono
+//raw PCM in rawFormat. Returns 0 on success; otherwise prints a message and returns 1.
+int openAudioFile( const char * path, int rawFormat, struct audioFile * af );
+void closeAudioFile( struct audioFile * af );
+//Converts count frames of one channel, starting at frame, to floats in [-1,1). Returns the number
+//of frames converted, which is smaller than count at the end of the file.
+size_t readAudioFile( const struct audioFile * af, size_t frame, int channel, float * out, size_t count );
+//The same, but to 16 bit samples, which 16 bit files are copied to as they are
+size_t readAudioFile16( const struct audioFile * af, size_t frame, int channel, int16_t * out, size_t count );
+
+#endif
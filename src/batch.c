@@ -0,0 +1,407 @@
+/* batch.c - scores many recordings at once on every core
+ *
+ * Recordings are cut into chunks of at most CHUNK_SECONDS, so one long
+ * file can keep several cores busy.  The chunks are dealt to per-thread
+ * deques largest first, and a thread that runs out steals from the
+ * others (see workqueue.h), so a mix of long and short files finishes
+ * together.  Each thread has its own analysis for each sample rate it
+ * meets.  A chunk's frames are kept rather than scored, and whichever
+ * thread finishes a recording's last chunk scores all of its frames in
+ * order, so a note held across a chunk boundary is still one note and
+ * the interval to the next is still counted: a recording scores as it
+ * does with -f.  Recordings are scored at the rate they were made at.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "libfft.h"
+#include "analysis.h"
+#include "audiofile.h"
+#include "workqueue.h"
+#include "framelog.h"
+#include "batch.h"
+
+#define CHUNK_SECONDS (60)
+#define MAX_PATH_LENGTH (4096)
+#define MAX_BATCH_RATES (4) //sample rates a thread keeps an analysis set up for at once
+#define WARMUP_WINDOWS (2) //analyzed before each chunk but the first, for the analysis to settle
+
+struct batchFile {
+   const char * path;
+   struct audioFile af;
+   bool ok; //opened and in a format we can score
+   struct analysisOptions options; //with the recording's sample rate, and the window and hop for it
+   int firstTask, numTasks; //its chunks, in order
+   pthread_mutex_t lock; //guards ok and tasksLeft
+   int tasksLeft;
+   struct scoreCard card;
+};
+
+struct batchTask {
+   int file;
+   size_t start, end; //frames [start, end) are scored
+   struct frameRecord * frames; //what they scored, until the recording is stitched together
+   int numFrames;
+};
+
+struct batch {
+   struct batchFile * files;
+   int numFiles;
+   struct batchTask * tasks;
+   int numTasks;
+   const struct dinoPitchOptions * options;
+   struct workQueue queue;
+   const volatile bool * running;
+};
+
+struct batchThreadArgs {
+   struct batch * batch;
+   int worker;
+};
+
+static int comparePaths( const void * a, const void * b ){
+   return strcmp( *(char * const *) a, *(char * const *) b );
+}
+
+static bool isRecording( const char * name ){
+   const char * dot = strrchr( name, '.' );
+   return dot && ( !strcasecmp( dot, ".wav" ) || !strcasecmp( dot, ".raw" ) || !strcasecmp( dot, ".pcm" ) );
+}
+
+//Appends a copy of path to the list, growing it as needed. Returns 0 on success.
+static int addPath( char *** paths, int * count, int * capacity, const char * path ){
+   if( *count == *capacity ) {
+      int newCapacity = *capacity ? *capacity * 2 : 64;
+      char ** grown = realloc( *paths, newCapacity * sizeof( char * ) );
+      if( !grown ) return 1;
+      *paths = grown;
+      *capacity = newCapacity;
+   }
+   if( !( (*paths)[*count] = strdup( path ) ) ) return 1;
+   ++*count;
+   return 0;
+}
+
+//Lists the recordings in a directory, sorted by name, or the paths in a list file, in order.
+//Returns the number found, or -1 on error.
+static int listRecordings( const char * path, char *** paths ){
+   struct stat st;
+   int count = 0, capacity = 0;
+   char line[MAX_PATH_LENGTH];
+   *paths = NULL;
+   if( stat( path, &st ) ) {
+      perror( path );
+      return -1;
+   }
+   if( S_ISDIR( st.st_mode ) ) {
+      DIR * dir = opendir( path );
+      struct dirent * entry;
+      if( !dir ) {
+         perror( path );
+         return -1;
+      }
+      while( ( entry = readdir( dir ) ) ) {
+         if( !isRecording( entry->d_name ) ) continue;
+         snprintf( line, sizeof( line ), "%s/%s", path, entry->d_name );
+         if( addPath( paths, &count, &capacity, line ) ) break;
+      }
+      closedir( dir );
+      qsort( *paths, count, sizeof( char * ), comparePaths );
+   } else {
+      FILE * list = fopen( path, "r" );
+      if( !list ) {
+         perror( path );
+         return -1;
+      }
+      while( fgets( line, sizeof( line ), list ) ) {
+         line[strcspn( line, "\r\n" )] = '\0';
+         if( line[0] == '\0' || line[0] == '#' ) continue;
+         if( addPath( paths, &count, &capacity, line ) ) break;
+      }
+      fclose( list );
+   }
+   return count;
+}
+
+//Filters count frames of a mono recording, from frame on, into an
+static void readHop( struct analysis * an, const struct audioFile * af, size_t frame, size_t count ){
+   if( an->fixedPoint ) {
+      readAudioFile16( af, frame, 0, an->input16, count );
+      filterInputFixed( an, an->input16, (int) count, 1 );
+   } else {
+      readAudioFile( af, frame, 0, an->input, count );
+      filterInput( an, an->input, (int) count, 1 );
+   }
+}
+
+//Analyzes one chunk into task's frames, leaving them to be scored with the rest of the recording's. The
+//WARMUP_WINDOWS windows before the chunk are analyzed first and thrown away, so the filters, the onset
+//gate and the detector have settled to where they would be had the whole recording been read in one go.
+//Returns 0 on success.
+static int scoreChunk( struct analysis * an, struct batchFile * file, struct batchTask * task,
+   const volatile bool * running ){
+   char * nearestNoteName;
+   float centsSharp;
+   size_t hop = an->hop;
+   size_t warmup = ( WARMUP_WINDOWS * (size_t) an->fftSize * an->decimation + hop - 1 ) / hop * hop;
+   if( warmup > task->start ) warmup = task->start;
+   int maxFrames = (int) ( ( task->end - task->start ) / hop ) + 1;
+   task->frames = malloc( maxFrames * sizeof( struct frameRecord ) );
+   if( !task->frames ) return 1;
+   resetAnalysis( an );
+   an->samplesIn = task->start - warmup; //so frames are dated from the start of the recording
+   an->frames = task->frames;
+   an->maxFrames = maxFrames;
+   for( size_t frame = task->start - warmup; frame < task->start; frame += hop ) {
+      readHop( an, &file->af, frame, hop );
+      analyzeHop( an, &nearestNoteName, &centsSharp );
+   }
+   an->numFrames = 0;
+   for( size_t frame = task->start; *running && frame + hop <= task->end; frame += hop ) {
+      readHop( an, &file->af, frame, hop );
+      analyzeHop( an, &nearestNoteName, &centsSharp );
+   }
+   task->numFrames = an->numFrames;
+   an->frames = NULL;
+   return 0;
+}
+
+//Scores the frames of every chunk of a recording, in order, into its card. Notes and intervals carry on
+//from one chunk to the next just as they do when the recording is scored in one go.
+static void stitchFile( struct batch * batch, struct batchFile * file ){
+   struct noteTracker notes;
+   initNoteTracker( &notes );
+   for( int t = file->firstTask; t < file->firstTask + file->numTasks; ++t ) {
+      struct batchTask * task = &batch->tasks[t];
+      if( file->ok )
+         scoreFrames( task->frames, task->numFrames, INT64_MIN, FRAME_LOG_NO_LIMIT, &file->card, &notes, 1 );
+      free( task->frames );
+      task->frames = NULL;
+   }
+   if( file->ok ) finishNote( &file->card, &notes );
+}
+
+//Returns this thread's analysis for recordings like file, setting one up if need be. When the thread
+//already has MAX_BATCH_RATES, the last one set up makes way. Returns NULL if it can't be set up.
+static struct analysis * analysisFor( struct analysis * ans, int * numAns, const struct batchFile * file ){
+   for( int i = 0; i < *numAns; ++i )
+      if( ans[i].inputRate == file->options.sampleRate )
+         return &ans[i];
+   if( *numAns == MAX_BATCH_RATES )
+      destroyAnalysis( &ans[--*numAns] );
+   if( initAnalysis( &ans[*numAns], &file->options ) ) return NULL;
+   return &ans[( *numAns )++];
+}
+
+static void * batchThread( void * arg ){
+   struct batchThreadArgs * args = arg;
+   struct batch * batch = args->batch;
+   struct analysis * ans = malloc( MAX_BATCH_RATES * sizeof( struct analysis ) ); //too big for the stack
+   int numAns = 0;
+   int task;
+   if( !ans ) fprintf( stderr, "Could not allocate for analysis.\n" );
+   while( *batch->running && nextTask( &batch->queue, args->worker, &task ) ) {
+      struct batchFile * file = &batch->files[batch->tasks[task].file];
+      struct analysis * an = ans ? analysisFor( ans, &numAns, file ) : NULL;
+      bool ok = an && !scoreChunk( an, file, &batch->tasks[task], batch->running );
+      if( !ok ) fprintf( stderr, "%s: could not allocate to score it\n", file->path );
+      pthread_mutex_lock( &file->lock );
+      if( !ok ) file->ok = false; //the recording can't be scored in full
+      bool last = --file->tasksLeft == 0;
+      pthread_mutex_unlock( &file->lock );
+      if( last ) stitchFile( batch, file ); //every other chunk is done, so nothing else touches the file
+   }
+   for( int i = 0; i < numAns; ++i )
+      destroyAnalysis( &ans[i] );
+   free( ans );
+   return NULL;
+}
+
+struct taskLength {
+   size_t length;
+   int task;
+};
+
+static int compareTaskLengths( const void * a, const void * b ){
+   const struct taskLength * x = a, * y = b;
+   return x->length > y->length ? -1 : x->length < y->length;
+}
+
+//Whole hops making up about CHUNK_SECONDS of a recording
+static size_t chunkFrames( const struct batchFile * file ){
+   size_t hop = file->options.hop;
+   return ( (size_t) CHUNK_SECONDS * file->options.sampleRate / hop ) * hop;
+}
+
+//Opens every recording and cuts them into chunks, each recording's in order. Returns 0 on success.
+static int planBatch( struct batch * batch, char * const * paths, int rawFormat ){
+   int capacity = 0;
+   batch->files = calloc( batch->numFiles, sizeof( struct batchFile ) );
+   if( !batch->files ) return 1;
+   for( int f = 0; f < batch->numFiles; ++f ) {
+      struct batchFile * file = &batch->files[f];
+      file->path = paths[f];
+      pthread_mutex_init( &file->lock, NULL );
+      initScoreCard( &file->card );
+      if( openAudioFile( file->path, rawFormat, &file->af ) ) continue;
+      struct dinoPitchOptions options = *batch->options;
+      if( file->af.sampleRate ) options.sampleRate = file->af.sampleRate;
+      int error = analysisOptionsFrom( &options, &file->options );
+      if( error ) {
+         fprintf( stderr, "%s: can't be scored at %d Hz: %s\n", file->path, options.sampleRate, dinoPitchError( error ) );
+         closeAudioFile( &file->af );
+         continue;
+      }
+      file->ok = true;
+      capacity += file->af.frames / chunkFrames( file ) + 1;
+   }
+   batch->tasks = calloc( capacity ? capacity : 1, sizeof( struct batchTask ) );
+   if( !batch->tasks ) return 1;
+   batch->numTasks = 0;
+   for( int f = 0; f < batch->numFiles; ++f ) {
+      struct batchFile * file = &batch->files[f];
+      if( !file->ok ) continue;
+      size_t frames = file->af.frames;
+      size_t chunk = chunkFrames( file );
+      file->firstTask = batch->numTasks;
+      for( size_t start = 0; start == 0 || start < frames; start += chunk ) {
+         struct batchTask * task = &batch->tasks[batch->numTasks++];
+         task->file = f;
+         task->start = start;
+         task->end = start + chunk < frames ? start + chunk : frames;
+      }
+      file->numTasks = file->tasksLeft = batch->numTasks - file->firstTask;
+   }
+   return 0;
+}
+
+//Closes and frees whatever planBatch() got to
+static void destroyBatch( struct batch * batch ){
+   for( int f = 0; batch->files && f < batch->numFiles; ++f ) {
+      struct batchFile * file = &batch->files[f];
+      if( file->af.map ) closeAudioFile( &file->af );
+      pthread_mutex_destroy( &file->lock );
+      destroyScoreCard( &file->card );
+   }
+   for( int t = 0; batch->tasks && t < batch->numTasks; ++t )
+      free( batch->tasks[t].frames );
+   free( batch->files );
+   free( batch->tasks );
+   destroyWorkQueue( &batch->queue );
+}
+
+//Deals the chunks out largest first, so every thread starts on big ones. Returns 0 on success.
+static int dealTasks( struct batch * batch, int numThreads ){
+   struct taskLength * lengths = malloc( ( batch->numTasks ? batch->numTasks : 1 ) * sizeof( struct taskLength ) );
+   if( !lengths ) return 1;
+   for( int t = 0; t < batch->numTasks; ++t ) {
+      lengths[t].length = batch->tasks[t].end - batch->tasks[t].start;
+      lengths[t].task = t;
+   }
+   qsort( lengths, batch->numTasks, sizeof( struct taskLength ), compareTaskLengths );
+   for( int t = 0; t < batch->numTasks; ++t )
+      pushTask( &batch->queue, t % numThreads, lengths[t].task );
+   free( lengths );
+   return 0;
+}
+
+int scoreRecordings( char * const * paths, int numPaths, int rawFormat, const struct dinoPitchOptions * options,
+   int numThreads, const volatile bool * running, struct scoreCard * cards, bool * scored ){
+   struct batch batch = { .numFiles = numPaths, .options = options, .running = running };
+   pthread_t * threads = NULL;
+   struct batchThreadArgs * args = NULL;
+   //what is wrong at any rate is said once, not for every recording
+   struct dinoPitchOptions anyRate = *options;
+   struct analysisOptions checked;
+   if( !anyRate.windowSize ) anyRate.windowSize = DINO_PITCH_MAX_WINDOW;
+   int error = analysisOptionsFrom( &anyRate, &checked );
+   if( error ) {
+      fprintf( stderr, "%s\n", dinoPitchError( error ) );
+      return 1;
+   }
+   if( planBatch( &batch, paths, rawFormat ) || initWorkQueue( &batch.queue, numThreads, batch.numTasks )
+      || dealTasks( &batch, numThreads ) || !( threads = malloc( numThreads * sizeof( pthread_t ) ) )
+      || !( args = malloc( numThreads * sizeof( struct batchThreadArgs ) ) ) ) {
+      fprintf( stderr, "Could not allocate for batch.\n" );
+      free( threads );
+      destroyBatch( &batch );
+      return 1;
+   }
+   int started = 0;
+   for( ; started < numThreads; ++started ) {
+      args[started].batch = &batch;
+      args[started].worker = started;
+      if( pthread_create( &threads[started], NULL, batchThread, &args[started] ) ) break;
+   }
+   if( started == 0 ) batchThread( &( struct batchThreadArgs ){ &batch, 0 } ); //stealing covers every deque
+   for( int w = 0; w < started; ++w )
+      pthread_join( threads[w], NULL );
+   free( threads );
+   free( args );
+
+   for( int f = 0; f < batch.numFiles; ++f ) {
+      struct batchFile * file = &batch.files[f];
+      if( file->ok && file->tasksLeft ) stitchFile( &batch, file ); //cut short; score what was done
+      cards[f] = file->card; //the card's intervals are the caller's now
+      initScoreCard( &file->card );
+      scored[f] = file->ok;
+   }
+   destroyBatch( &batch );
+   return 0;
+}
+
+int scoreBatch( const char * path, int rawFormat, const struct dinoPitchOptions * options, int numThreads,
+   const volatile bool * running ){
+   char ** paths;
+   int numFiles = listRecordings( path, &paths );
+   int failed = 0;
+   if( numFiles < 0 ) return 1;
+   if( numFiles == 0 ) {
+      fprintf( stderr, "%s: no recordings found\n", path );
+      free( paths );
+      return 1;
+   }
+   struct scoreCard * cards = malloc( numFiles * sizeof( struct scoreCard ) );
+   bool * scored = malloc( numFiles * sizeof( bool ) );
+   if( !cards || !scored ) fprintf( stderr, "Could not allocate for batch.\n" );
+   if( !cards || !scored
+      || scoreRecordings( paths, numFiles, rawFormat, options, numThreads, running, cards, scored ) ) {
+      for( int f = 0; f < numFiles; ++f )
+         free( paths[f] );
+      free( paths );
+      free( cards );
+      free( scored );
+      return 1;
+   }
+
+   struct scoreCard total;
+   initScoreCard( &total );
+   int numScored = 0;
+   for( int f = 0; f < numFiles; ++f ) {
+      printf( "=== %s ===\n", paths[f] );
+      if( scored[f] ) {
+         printResults( &cards[f] );
+         mergeScoreCards( &total, &cards[f] );
+         ++numScored;
+      } else {
+         printf( "Could not be scored.\n" );
+         failed = 1;
+      }
+      printf( "\n" );
+      destroyScoreCard( &cards[f] );
+      free( paths[f] );
+   }
+   printf( "=== All %d recordings ===\n", numScored );
+   printResults( &total );
+
+   destroyScoreCard( &total );
+   free( cards );
+   free( scored );
+   free( paths );
+   return failed;
+}
@@ -0,0 +1,22 @@
+/* batch.h - scores many recordings at once on every core */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "dinopitch.h"
+#include "stats.h"
+
+//Scores every recording in a directory, or every path listed one per line in a file, on numThreads
+//threads. Each is scored at the rate it was made at, or options' for a raw recording; options' channels
+//must be 1. Prints a report for each recording and one for all of them together. Returns 0 if every
+//recording could be scored.
+int scoreBatch( const char * path, int rawFormat, const struct dinoPitchOptions * options, int numThreads,
+   const volatile bool * running );
+//Scores the recordings at paths as scoreBatch() does, into cards[0..numPaths), which it sets up and the
+//caller destroys. scored[f] is false for any that could not be scored. Returns 0 on success; otherwise
+//prints a message and returns 1.
+int scoreRecordings( char * const * paths, int numPaths, int rawFormat, const struct dinoPitchOptions * options,
+   int numThreads, const volatile bool * running, struct scoreCard * cards, bool * scored );
+
+#endif
@@ -0,0 +1,160 @@
+/* detector.c - the pitch detectors analyzeHop() can use */
+
+#include "detector.h"
+#include <string.h>
+#include <math.h>
+#include "libfft.h"
+#include "dsp.h"
+#include "tables.h"
+#include "yin.h"
+#include "analysis.h"
+
+static const struct pitchDetector * const detectors[] = { &fftDetector, &yinDetector, &multiDetector, &bankDetector };
+
+const struct pitchDetector * findDetector( const char * name ){
+   for( int i = 0; i < (int)( sizeof( detectors ) / sizeof( detectors[0] ) ); ++i )
+      if( !strcmp( detectors[i]->name, name ) )
+         return detectors[i];
+   return NULL;
+}
+
+static int fftInit( struct analysis * an ){
+   int bits = 0;
+   while( ( 1 << bits ) < an->fftSize )
+      ++bits;
+   an->frameSize = an->fftSize;
+   an->fft = initfft( bits );
+   if( !an->fft ) return 1;
+   an->window = hanWindows[bits];
+   return 0;
+}
+
+static void fftDestroy( struct analysis * an ){
+   destroyfft( an->fft );
+}
+
+//Windows the whole ring, transforms it and interpolates the loudest bin
+static float fftDetect( struct analysis * an ){
+   float * data = an->data;
+   float * datai = an->datai;
+   uint64_t t = monotonicNanos();
+   //filterInput() already windowed data if it filled all of it since the last fft
+   if( an->samplesWindowed < an->fftSize || an->ringPos != 0 )
+      applyWindow( an->window, an->ring, an->ringPos, data, an->fftSize );
+   an->samplesWindowed = 0;
+   t = recordStage( &an->metrics, STAGE_WINDOW, t );
+
+   // do the fft; only bins 0..fftSize/2 come back, in data and datai
+   applyrealfft( an->fft, data, data, datai );
+   t = recordStage( &an->metrics, STAGE_FFT, t );
+
+   int maxIndex = findPeak( data, datai, an->fftSize/2 );
+   float bin = maxIndex + interpolatePeak( data, datai, an->fftSize/2, maxIndex );
+   //the transform is scaled by 1/fftSize and the Han window halves a tone, so a full scale sine peaks at 1/4
+   an->amplitude = 4 * sqrtf( data[maxIndex] * data[maxIndex] + datai[maxIndex] * datai[maxIndex] );
+   recordStage( &an->metrics, STAGE_PEAK, t );
+   return bin * an->sampleRate / an->fftSize; //a bin 0 peak has no pitch
+}
+
+const struct pitchDetector fftDetector = { "fft", fftInit, fftDestroy, fftDetect };
+
+static int yinInit( struct analysis * an ){
+   if( initYin( &an->yin, an->sampleRate ) ) return 1;
+   if( an->yin.frameSize > an->fftSize ) { //the ring must hold a whole frame
+      destroyYin( &an->yin );
+      return 1;
+   }
+   an->frameSize = an->yin.frameSize;
+   return 0;
+}
+
+static void yinDestroy( struct analysis * an ){
+   destroyYin( &an->yin );
+}
+
+static float yinDetect( struct analysis * an ){
+   uint64_t start = monotonicNanos();
+   float freq = yinPitch( &an->yin, an->ring, an->ringPos, an->fftSize );
+   an->amplitude = an->yin.amplitude;
+   recordStage( &an->metrics, STAGE_YIN, start );
+   return freq;
+}
+
+const struct pitchDetector yinDetector = { "yin", yinInit, yinDestroy, yinDetect };
+
+static int multiInit( struct analysis * an ){
+   an->frameSize = an->fftSize; //the longest window still needs the whole ring
+   return initMultiResolution( &an->multi, an->fftSize, an->sampleRate );
+}
+
+static void multiDestroy( struct analysis * an ){
+   destroyMultiResolution( &an->multi );
+}
+
+static float multiDetect( struct analysis * an ){
+   return multiResolutionPitch( &an->multi, an->ring, an->ringPos, an->fftSize, an->data, an->datai,
+      &an->amplitude, &an->metrics );
+}
+
+const struct pitchDetector multiDetector = { "multi", multiInit, multiDestroy, multiDetect };
+
+static int bankInit( struct analysis * an ){
+   if( initNoteBank( &an->bank, an->sampleRate, an->lowNote, an->highNote, an->fftSize, an->hop / an->decimation ) )
+      return 1;
+   an->frameSize = an->bank.maxSize;
+   return 0;
+}
+
+static void bankDestroy( struct analysis * an ){
+   destroyNoteBank( &an->bank );
+}
+
+static float bankDetect( struct analysis * an ){
+   uint64_t start = monotonicNanos();
+   float freq = noteBankPitch( &an->bank, an->ring, an->ringPos, an->fftSize, an->samplesIn / an->decimation,
+      &an->amplitude );
+   recordStage( &an->metrics, STAGE_BANK, start );
+   return freq;
+}
+
+const struct pitchDetector bankDetector = { "bank", bankInit, bankDestroy, bankDetect };
+
+static int fixedInit( struct analysis * an ){
+   int bits = 0;
+   while( ( 1 << bits ) < an->fftSize )
+      ++bits;
+   an->frameSize = an->fftSize;
+   if( initFixedFft( &an->fixedFft, an->fftSize ) ) return 1;
+   an->window16 = fixedHanWindows[bits];
+   return 0;
+}
+
+static void fixedDestroy( struct analysis * an ){
+   //the window and the FFT's tables are shared, so there is nothing to free
+}
+
+//fftDetect() in fixed point, down to the three bins around the peak
+static float fixedDetect( struct analysis * an ){
+   int32_t * data = an->fixedData;
+   int32_t * datai = an->fixedDatai;
+   uint64_t t = monotonicNanos();
+   applyFixedWindow( an->window16, an->ring16, an->ringPos, data, an->fftSize );
+   t = recordStage( &an->metrics, STAGE_WINDOW, t );
+
+   applyFixedRealFft( &an->fixedFft, data, data, datai );
+   t = recordStage( &an->metrics, STAGE_FFT, t );
+
+   int maxIndex = findFixedPeak( data, datai, an->fftSize/2 );
+   float re[3] = { 0 }, im[3] = { 0 };
+   for( int k = -1; k <= 1; ++k ) {
+      if( maxIndex + k < 0 || maxIndex + k > an->fftSize/2 ) continue;
+      re[k + 1] = data[maxIndex + k] * ( 1.0f / 2147483648.0f );
+      im[k + 1] = datai[maxIndex + k] * ( 1.0f / 2147483648.0f );
+   }
+   float bin = maxIndex + ( maxIndex > 0 ? interpolatePeak( re, im, 3, 1 ) : 0 );
+   an->amplitude = 4 * sqrtf( re[1] * re[1] + im[1] * im[1] );
+   recordStage( &an->metrics, STAGE_PEAK, t );
+   return bin * an->sampleRate / an->fftSize;
+}
+
+const struct pitchDetector fixedDetector = { "fixed", fixedInit, fixedDestroy, fixedDetect };
@@ -0,0 +1,32 @@
+/* detector.h - the pitch detectors analyzeHop() can use
+ *
+ * Every detector looks at the newest samples in a channel's ring and
+ * returns a frequency.  Turning that into a note, cents and a score is the
+ * same for all of them, so a new detector only has to fill in one of
+ * these.
+ */
+
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+struct analysis;
+
+struct pitchDetector {
+   const char * name; //as given on the command line
+   //Sets up what the detector keeps in an, including an->frameSize. Returns 0 on success.
+   int (*init)( struct analysis * an );
+   void (*destroy)( struct analysis * an );
+   //Returns the pitch in Hz of the newest frameSize samples in the ring, or 0 if they have none
+   float (*detect)( struct analysis * an );
+};
+
+extern const struct pitchDetector fftDetector; //peak of the magnitude spectrum over the whole ring
+extern const struct pitchDetector yinDetector; //YIN over the last 50 ms or so
+extern const struct pitchDetector multiDetector; //spectrum peak over the shortest window that resolves it
+extern const struct pitchDetector bankDetector; //loudest of a sliding DFT bin per note in the singer's range
+extern const struct pitchDetector fixedDetector; //fft in fixed point; chosen by fixedPoint, not by name
+
+//Returns the detector called name, or NULL if there is none
+const struct pitchDetector * findDetector( const char * name );
+
+#endif
@@ -0,0 +1,231 @@
+/* dinopitch.c - the analysis pipeline as a library, one context per singer or ensemble */
+
+#include "dinopitch.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include "dsp.h"
+#include "analysis.h"
+
+/* -- what a channel has waiting -- */
+struct dinoChannel {
+   int buffered; //samples pushed toward the next hop
+   int firstFrame, numFrames; //waiting in frames, as a ring
+   struct dinoPitchFrame frames[DINO_PITCH_FRAMES];
+   char pad[BUFFER_ALIGNMENT]; //so threads on neighbouring channels don't share a cache line
+};
+
+struct dinoPitch {
+   struct dinoPitchOptions options; //with the window and hop filled in
+   int numChannels;
+   struct analysis * ans; //one per channel
+   struct dinoChannel * channels;
+};
+
+static const char * const errors[DINO_PITCH_NUM_ERRORS] = {
+   [DINO_PITCH_OK] = "No error",
+   [DINO_PITCH_NO_MEMORY] = "Could not allocate for analysis",
+   [DINO_PITCH_BAD_DETECTOR] = "Pitch detector must be fft, yin, multi or bank",
+   [DINO_PITCH_BAD_RATE] = "Sample rate must be positive",
+   [DINO_PITCH_BAD_WINDOW] = "Window must be a power of two from 256 to 65536 samples",
+   [DINO_PITCH_BAD_HOP] = "Hop size must be at least 1 and at most the window",
+   [DINO_PITCH_BAD_DECIMATION] = "Decimation must be 1, 2, 4 or 8",
+   [DINO_PITCH_BAD_HOP_DECIMATION] = "Hop size must be a multiple of the decimation",
+   [DINO_PITCH_BAD_NOTE_RANGE] = "Note range must run from low to high",
+   [DINO_PITCH_BAD_FIXED_POINT] = "Fixed point analysis only runs the fft detector, without decimation",
+   [DINO_PITCH_BAD_CHANNELS] = "Channel count must be between 1 and 64",
+   [DINO_PITCH_DETECTOR_FAILED] = "The pitch detector can't be set up for this window at this sample rate",
+   [DINO_PITCH_WRONG_SAMPLES] = "Only a fixed point context takes 16 bit samples, and it takes nothing else"
+};
+
+void defaultDinoPitchOptions( struct dinoPitchOptions * options ){
+   options->sampleRate = DEFAULT_SAMPLE_RATE;
+   options->windowSize = 0;
+   options->hop = 0;
+   options->decimation = 1;
+   options->detector = fftDetector.name;
+   options->lowNote = DEFAULT_LOW_NOTE;
+   options->highNote = DEFAULT_HIGH_NOTE;
+   options->noiseFloor = DEFAULT_NOISE_FLOOR_DB;
+   options->fixedPoint = false;
+   options->channels = 1;
+   options->melody = NULL;
+}
+
+int createDinoPitch( const struct dinoPitchOptions * options, struct dinoPitch ** pp ){
+   struct analysisOptions analysisOptions;
+   *pp = NULL;
+   if( options->channels < 1 || options->channels > DINO_PITCH_MAX_CHANNELS ) return DINO_PITCH_BAD_CHANNELS;
+   int error = analysisOptionsFrom( options, &analysisOptions );
+   if( error ) return error;
+   struct dinoPitch * p = malloc( sizeof( struct dinoPitch ) );
+   if( !p ) return DINO_PITCH_NO_MEMORY;
+   p->options = *options;
+   p->options.windowSize = analysisOptions.fftSize;
+   p->options.hop = analysisOptions.hop;
+   p->numChannels = options->channels;
+   if( posix_memalign( (void **) &p->channels, BUFFER_ALIGNMENT, p->numChannels * sizeof( struct dinoChannel ) ) ) {
+      free( p );
+      return DINO_PITCH_NO_MEMORY;
+   }
+   error = createAnalyses( p->numChannels, &analysisOptions, &p->ans );
+   if( error ) {
+      free( p->channels );
+      free( p );
+      return error;
+   }
+   resetDinoPitch( p );
+   *pp = p;
+   return DINO_PITCH_OK;
+}
+
+void destroyDinoPitch( struct dinoPitch * p ){
+   if( !p ) return;
+   destroyAnalyses( p->ans, p->numChannels );
+   free( p->channels );
+   free( p );
+}
+
+void getDinoPitchOptions( const struct dinoPitch * p, struct dinoPitchOptions * options ){
+   *options = p->options;
+}
+
+void resetDinoPitch( struct dinoPitch * p ){
+   for( int c = 0; c < p->numChannels; ++c ) {
+      resetAnalysis( &p->ans[c] );
+      p->channels[c].buffered = 0;
+      p->channels[c].firstFrame = p->channels[c].numFrames = 0;
+   }
+}
+
+void logDinoPitch( struct dinoPitch * p, struct frameLog * log, int64_t start ){
+   logAnalyses( p->ans, p->numChannels, log, start );
+}
+
+//Queues what analyzeHop() found in the hop channel c just analyzed
+static void addFrame( struct dinoPitch * p, int c, float centsSharp ){
+   struct analysis * an = &p->ans[c];
+   struct dinoChannel * ch = &p->channels[c];
+   struct dinoPitchFrame * frame = &ch->frames[( ch->firstFrame + ch->numFrames++ ) % DINO_PITCH_FRAMES];
+   frame->time = an->samplesIn * 1000000 / an->inputRate;
+   frame->frequency = an->frequency;
+   frame->midiNote = (int) floorf( frequencyToMidi( an->frequency ) + .5 );
+   frame->centsSharp = centsSharp;
+   frame->amplitude = an->amplitude;
+   frame->onset = an->started;
+   frame->scored = an->scored;
+   frame->scoredNote = an->scored ? an->scoredNote : frame->midiNote;
+   frame->scoredCents = an->scored ? an->scoredCents : centsSharp;
+}
+
+//Samples channels [first, end) can all take before one of them might find a pitch with no room to queue it
+static int room( const struct dinoPitch * p, int first, int end ){
+   long long most = INT_MAX;
+   for( int c = first; c < end; ++c ) {
+      const struct dinoChannel * ch = &p->channels[c];
+      long long n = (long long)( DINO_PITCH_FRAMES - ch->numFrames ) * p->ans[c].hop - ch->buffered;
+      if( n < most ) most = n;
+   }
+   return (int) most;
+}
+
+//Filters up to count frames of channels [first, end), from samples or else samples16, into their analyses
+//and analyzes each channel's every hop. The filtering is timed against the first channel.
+static int push( struct dinoPitch * p, int first, int end, const float * samples, const int16_t * samples16,
+   int count, int stride ){
+   int taken = 0;
+   while( taken < count ) {
+      int n = room( p, first, end );
+      if( n <= 0 ) break;
+      if( n > count - taken ) n = count - taken;
+      while( n > 0 ) {
+         int piece = n; //up to the next hop of any channel
+         for( int c = first; c < end; ++c )
+            if( p->ans[c].hop - p->channels[c].buffered < piece )
+               piece = p->ans[c].hop - p->channels[c].buffered;
+         uint64_t t = monotonicNanos();
+         if( samples16 ) {
+            for( int c = first; c < end; ++c )
+               filterInputFixed( &p->ans[c], samples16 + (long) taken * stride + c - first, piece, stride );
+         } else {
+            filterInputs( &p->ans[first], end - first, samples + (long) taken * stride, piece, stride );
+         }
+         recordStage( &p->ans[first].metrics, STAGE_FILTER, t );
+         for( int c = first; c < end; ++c ) {
+            struct dinoChannel * ch = &p->channels[c];
+            ch->buffered += piece;
+            if( ch->buffered < p->ans[c].hop ) continue;
+            ch->buffered = 0;
+            char * nearestNoteName;
+            float centsSharp;
+            if( analyzeHop( &p->ans[c], &nearestNoteName, &centsSharp ) )
+               addFrame( p, c, centsSharp );
+         }
+         taken += piece;
+         n -= piece;
+      }
+   }
+   return taken;
+}
+
+int pushDinoPitch( struct dinoPitch * p, const float * samples, int count, int stride ){
+   return pushDinoPitchChannels( p, 0, p->numChannels, samples, count, stride );
+}
+
+int pushDinoPitchChannels( struct dinoPitch * p, int first, int numChannels, const float * samples, int count,
+   int stride ){
+   if( first < 0 || numChannels < 1 || first + numChannels > p->numChannels ) return -DINO_PITCH_BAD_CHANNELS;
+   if( p->options.fixedPoint ) return -DINO_PITCH_WRONG_SAMPLES;
+   return push( p, first, first + numChannels, samples, NULL, count, stride );
+}
+
+int pushDinoPitch16( struct dinoPitch * p, const int16_t * samples, int count, int stride ){
+   return pushDinoPitchChannels16( p, 0, p->numChannels, samples, count, stride );
+}
+
+int pushDinoPitchChannels16( struct dinoPitch * p, int first, int numChannels, const int16_t * samples, int count,
+   int stride ){
+   if( first < 0 || numChannels < 1 || first + numChannels > p->numChannels ) return -DINO_PITCH_BAD_CHANNELS;
+   if( !p->options.fixedPoint ) return -DINO_PITCH_WRONG_SAMPLES;
+   return push( p, first, first + numChannels, NULL, samples, count, stride );
+}
+
+int pullDinoPitch( struct dinoPitch * p, int channel, struct dinoPitchFrame * frames, int max ){
+   struct dinoChannel * ch = &p->channels[channel];
+   int n = max < ch->numFrames ? max : ch->numFrames;
+   for( int i = 0; i < n; ++i )
+      frames[i] = ch->frames[( ch->firstFrame + i ) % DINO_PITCH_FRAMES];
+   ch->firstFrame = ( ch->firstFrame + n ) % DINO_PITCH_FRAMES;
+   ch->numFrames -= n;
+   return n;
+}
+
+void finishDinoPitch( struct dinoPitch * p ){
+   finishAnalyses( p->ans, p->numChannels );
+}
+
+void scoreDinoPitch( const struct dinoPitch * p, int channel, struct dinoPitchScore * score ){
+   const struct scoreCard * card = &p->ans[channel].card;
+   score->frames = card->numInputs;
+   score->accurate = card->numAccurate;
+   score->precision = card->numInputs ? card->score / card->numInputs : 0;
+   score->notes = card->numNotes;
+   score->silentHops = p->ans[channel].silentHops;
+}
+
+void printDinoPitch( struct dinoPitch * p, int channel ){
+   printResults( &p->ans[channel].card );
+}
+
+void addDinoPitchMetrics( const struct dinoPitch * p, struct metrics * total ){
+   for( int c = 0; c < p->numChannels; ++c )
+      mergeMetrics( total, &p->ans[c].metrics );
+}
+
+const char * dinoPitchError( int error ){
+   return error >= 0 && error < DINO_PITCH_NUM_ERRORS ? errors[error] : "Unknown error";
+}
+
+const char * dinoPitchNoteName( int midiNote ){
+   return NOTES[( midiNote % NUMNOTES + NUMNOTES ) % NUMNOTES];
+}
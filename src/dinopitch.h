@@ -0,0 +1,134 @@
+/* dinopitch.h - the analysis pipeline as a library, one context per singer or ensemble
+ *
+ * Everything a stream of samples needs on its way to a score lives in a
+ * struct dinoPitch: for each channel of the input, the filter, ring and
+ * detector state, the note tracker and score card, and a queue of
+ * results not yet collected.  The library keeps no state of its own; the
+ * windows and FFT tables every context reads are constants built into it
+ * (see tables.h), so a server can host as many contexts as it has clients
+ * and drive each from whichever thread has its input.
+ *
+ * A context is set up once with all its buffers, each on its own cache
+ * line; pushing and pulling then do no allocation, so their cost is the
+ * analysis and nothing else.  Samples are pushed in whatever blocks they
+ * arrive in; a pitch is worked out every hop and waits in the context
+ * until it is pulled.  When DINO_PITCH_FRAMES wait on a channel, pushing
+ * stops taking samples until some are pulled, rather than losing any.
+ * Nothing is printed unless asked for: what goes wrong comes back as one
+ * of the DINO_PITCH_ error codes, which dinoPitchError() puts into words.
+ */
+
+#ifndef DINOPITCH_H
+#define DINOPITCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DINO_PITCH_FRAMES (64) //results each channel of a context holds for pullDinoPitch()
+#define DINO_PITCH_MAX_CHANNELS (64)
+#define DINO_PITCH_MIN_WINDOW (256)
+#define DINO_PITCH_MAX_WINDOW (65536)
+#define DINO_PITCH_HOPS_PER_WINDOW (16) //to the default hop
+
+struct dinoPitch;
+struct melody; //see melody.h
+struct frameLog; //see framelog.h
+struct metrics; //see metrics.h
+
+/* -- what can go wrong -- */
+enum {
+   DINO_PITCH_OK,
+   DINO_PITCH_NO_MEMORY,
+   DINO_PITCH_BAD_DETECTOR,
+   DINO_PITCH_BAD_RATE,
+   DINO_PITCH_BAD_WINDOW,
+   DINO_PITCH_BAD_HOP,
+   DINO_PITCH_BAD_DECIMATION,
+   DINO_PITCH_BAD_HOP_DECIMATION,
+   DINO_PITCH_BAD_NOTE_RANGE,
+   DINO_PITCH_BAD_FIXED_POINT,
+   DINO_PITCH_BAD_CHANNELS,
+   DINO_PITCH_DETECTOR_FAILED, //the detector can't work with the window at the sample rate
+   DINO_PITCH_WRONG_SAMPLES, //floats pushed to a fixed point context, or 16 bit samples to any other
+   DINO_PITCH_NUM_ERRORS
+};
+
+/* -- how a context analyzes its input; start from defaultDinoPitchOptions() -- */
+struct dinoPitchOptions {
+   int sampleRate; //in Hz
+   int windowSize; //samples, a power of two; 0 for about a second
+   int hop; //samples between pitches; 0 for a sixteenth of the window
+   int decimation; //1, 2, 4 or 8
+   const char * detector; //fft, yin, multi or bank
+   int lowNote, highNote; //MIDI notes the bank detector listens for
+   float noiseFloor; //dB relative to a full scale sine; quieter hops have no pitch
+   bool fixedPoint; //take 16 bit samples and analyze them in fixed point; needs fft and no decimation
+   int channels; //interleaved in the input, each analyzed and scored on its own
+   const struct melody * melody; //NULL, or what every channel is scored against instead of the nearest note;
+                                 //it must outlast the context
+};
+
+/* -- one hop's pitch on one channel -- */
+struct dinoPitchFrame {
+   int64_t time; //microseconds from the first sample pushed to the end of the hop
+   float frequency; //in Hz
+   int midiNote; //the nearest note
+   float centsSharp; //of it
+   float amplitude; //1 for a full scale sine
+   bool onset; //a note started with this frame
+   bool scored; //it counts toward the score; a pitch sung in a rest of the melody doesn't
+   int scoredNote; //what it was scored against: the melody's note, or else the nearest
+   float scoredCents; //sharp of that
+};
+
+/* -- a channel's score so far -- */
+struct dinoPitchScore {
+   int frames; //scored
+   int accurate; //frames within the accuracy threshold
+   float precision; //mean score out of 100
+   int notes; //note events
+   long long silentHops; //too quiet to have a pitch
+};
+
+void defaultDinoPitchOptions( struct dinoPitchOptions * options );
+//Sets *p to a new context. Returns DINO_PITCH_OK, or what is wrong with the options.
+int createDinoPitch( const struct dinoPitchOptions * options, struct dinoPitch ** p );
+void destroyDinoPitch( struct dinoPitch * p );
+//Fills in the options p was made with, including the window and hop it chose for any left at 0
+void getDinoPitchOptions( const struct dinoPitch * p, struct dinoPitchOptions * options );
+//Forgets all input, results and scores, for a new recording
+void resetDinoPitch( struct dinoPitch * p );
+//Has every frame scored from now on written to log as well (see framelog.h), dated from start, the time
+//of the first sample pushed in microseconds since the Unix epoch. log must stay open until the last push.
+void logDinoPitch( struct dinoPitch * p, struct frameLog * log, int64_t start );
+
+//Analyzes up to count frames of interleaved samples, stride apart, each holding every channel. Returns
+//how many frames were taken, which is less than count only if a channel has DINO_PITCH_FRAMES results
+//waiting to be pulled, or -DINO_PITCH_WRONG_SAMPLES from a fixed point context.
+int pushDinoPitch( struct dinoPitch * p, const float * samples, int count, int stride );
+//The same for numChannels channels from first on, whose samples in a frame start at samples[0]. Separate
+//threads may push to and pull from separate channels at once. Returns -DINO_PITCH_BAD_CHANNELS if the
+//context doesn't have them.
+int pushDinoPitchChannels( struct dinoPitch * p, int first, int numChannels, const float * samples, int count,
+   int stride );
+//The same as those two for a context with fixedPoint set, which only takes 16 bit samples
+int pushDinoPitch16( struct dinoPitch * p, const int16_t * samples, int count, int stride );
+int pushDinoPitchChannels16( struct dinoPitch * p, int first, int numChannels, const int16_t * samples, int count,
+   int stride );
+//Moves up to max of channel's waiting results, oldest first, to frames. Returns how many were moved.
+int pullDinoPitch( struct dinoPitch * p, int channel, struct dinoPitchFrame * frames, int max );
+//Scores the note being sung on every channel as over, when the input has ended
+void finishDinoPitch( struct dinoPitch * p );
+void scoreDinoPitch( const struct dinoPitch * p, int channel, struct dinoPitchScore * score );
+//Prints channel's full report to standard output: the scores, problem notes and intervals, and how far
+//off each note usually was
+void printDinoPitch( struct dinoPitch * p, int channel );
+//Adds how long each stage of every channel's analysis took to total (see metrics.h)
+void addDinoPitchMetrics( const struct dinoPitch * p, struct metrics * total );
+
+//Says what an error code means, as a sentence without a full stop
+const char * dinoPitchError( int error );
+//The name of a MIDI note without its octave, such as C#
+const char * dinoPitchNoteName( int midiNote );
+
+#endif
@@ -0,0 +1,68 @@
+/* display.c - flicker-free terminal output at a capped frame rate */
+
+#include "display.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+static double monotonicSeconds( void ){
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void initDisplay( struct display * d, double rate, bool headless ){
+   memset( d, 0, sizeof( *d ) );
+   d->headless = headless;
+   d->interval = 1 / rate;
+   d->lastDrawn = monotonicSeconds() - d->interval;
+}
+
+bool displayDue( struct display * d ){
+   return !d->headless && monotonicSeconds() - d->lastDrawn >= d->interval;
+}
+
+void setDisplayLine( struct display * d, int line, const char * format, ... ){
+   if( line < 0 || line >= DISPLAY_MAX_LINES ) return;
+   va_list args;
+   va_start( args, format );
+   vsnprintf( d->next[line], DISPLAY_WIDTH, format, args );
+   va_end( args );
+   if( line >= d->numLines ) d->numLines = line + 1;
+}
+
+void drawDisplay( struct display * d ){
+   char * p = d->out;
+   int lines = d->numLines > d->shownLines ? d->numLines : d->shownLines;
+   if( !d->cleared ) {
+      p += sprintf( p, "\033[2J" ); //only ever once
+      d->cleared = true;
+      for( int i = 0; i < DISPLAY_MAX_LINES; ++i )
+         d->shown[i][0] = 1; //matches no line, so all are drawn
+   }
+   for( int i = 0; i < lines; ++i ) {
+      if( !strcmp( d->next[i], d->shown[i] ) ) continue;
+      p += sprintf( p, "\033[%d;1H%s\033[K", i + 1, d->next[i] ); //the rest of the old line is erased
+      strcpy( d->shown[i], d->next[i] );
+   }
+   if( p != d->out ) //an unchanged frame costs no output at all
+      p += sprintf( p, "\033[%d;1H", lines + 1 );
+   d->shownLines = d->numLines;
+
+   //anything printed before, such as the device name, has to go out first
+   fflush( stdout );
+   const char * q = d->out;
+   while( q < p ) {
+      ssize_t n = write( STDOUT_FILENO, q, p - q );
+      if( n < 0 && errno == EINTR ) continue;
+      if( n <= 0 ) break; //the terminal is gone; the next frame will try again
+      q += n;
+   }
+   for( int i = 0; i < d->numLines; ++i )
+      d->next[i][0] = '\0';
+   d->numLines = 0;
+   d->lastDrawn = monotonicSeconds();
+}
@@ -0,0 +1,40 @@
+/* display.h - flicker-free terminal output at a capped frame rate
+ *
+ * A frame is built line by line in memory, compared with what is already
+ * on the screen, and only the lines that changed are rewritten, each
+ * after a cursor move, in a single write.  The screen is cleared once, on
+ * the first frame, so nothing flickers and very little goes over a slow
+ * link.  Frames are drawn no more often than the rate asked for, however
+ * often the pitch changes, and a headless display draws nothing at all.
+ */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdbool.h>
+
+#define DISPLAY_WIDTH (128) //characters kept of each line
+#define DISPLAY_MAX_LINES (72)
+
+struct display {
+   bool headless;
+   double interval; //least seconds between frames
+   double lastDrawn; //monotonic seconds
+   bool cleared; //the screen has been cleared for the first frame
+   int numLines; //lines in the frame being built
+   int shownLines; //lines on the screen
+   char next[DISPLAY_MAX_LINES][DISPLAY_WIDTH];
+   char shown[DISPLAY_MAX_LINES][DISPLAY_WIDTH];
+   char out[DISPLAY_MAX_LINES * ( DISPLAY_WIDTH + 16 ) + 16]; //every line rewritten, with its cursor moves
+};
+
+//Sets up for at most rate frames a second, or for drawing nothing if headless
+void initDisplay( struct display * d, double rate, bool headless );
+//Returns true if a frame may be drawn now: the display isn't headless and the last frame is old enough
+bool displayDue( struct display * d );
+//Sets a line of the next frame, printf style. Lines not set are left blank.
+void setDisplayLine( struct display * d, int line, const char * format, ... );
+//Writes the lines that differ from the screen and leaves the cursor below the frame
+void drawDisplay( struct display * d );
+
+#endif
@@ -0,0 +1,251 @@
+/* dsp.c - filter, window and note helpers shared by the tuner and the benchmarks */
+
+#include "dsp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+#define TINY (1e-30f) //keeps logf() finite for empty bins
+
+char * NOTES[NUMNOTES] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+//Multiplies audio input by window signal to reduce reading of frequencies that are not actually present.
+//ring holds size samples with the oldest at start; the windowed samples are written to data in time order,
+//so the ring never has to be shifted.
+void applyWindow( const float *window, float *ring, int start, float *data, int size )
+{
+   int first = size - start;
+   for( int i=0; i<first; ++i )
+      data[i] = ring[start+i] * window[i] ;
+   for( int i=first; i<size; ++i )
+      data[i] = ring[i-first] * window[i] ;
+}
+
+void applyRecentWindow( const float *window, const float *ring, int ringSize, int start, float *data, int size )
+{
+   int first = ( start + ringSize - size ) % ringSize; //the oldest sample wanted
+   int n = ringSize - first < size ? ringSize - first : size; //up to the end of the ring
+   for( int i=0; i<n; ++i )
+      data[i] = ring[first+i] * window[i] ;
+   for( int i=n; i<size; ++i )
+      data[i] = ring[i-n] * window[i] ;
+}
+
+//Computes low pass parameters in order to filter out misleading higher frequencies
+void computeSecondOrderLowPassParameters( float srate, float f, float *a, float *b )
+{
+   float a0;
+   float w0 = 2 * M_PI * f/srate;
+   float cosw0 = cos(w0);
+   float sinw0 = sin(w0);
+   //float alpha = sinw0/2;
+   float alpha = sinw0/2 * sqrt(2);
+
+   a0   = 1 + alpha;
+   a[0] = (-2*cosw0) / a0;
+   a[1] = (1 - alpha) / a0;
+   b[0] = ((1-cosw0)/2) / a0;
+   b[1] = ( 1-cosw0) / a0;
+   b[2] = b[0];
+}
+
+//Applies the low pass filter to the audio to filter out misleading higher frequencies
+float processSecondOrderFilter( float x, float *mem, float *a, float *b )
+{
+    float ret = b[0] * x + b[1] * mem[0] + b[2] * mem[1]
+                         - a[0] * mem[2] - a[1] * mem[3] ;
+      mem[1] = mem[0];
+      mem[0] = x;
+      mem[3] = mem[2];
+      mem[2] = ret;
+
+      return ret;
+
+}
+
+//One section of processSecondOrderFilter() with its state passed in and out by value, so a loop
+//over a block keeps it in registers.
+#define BIQUAD_STEP( x, y, x1, x2, y1, y2, b0, b1, b2, a0, a1 ) \
+   do { \
+      y = b0 * x + b1 * x1 + b2 * x2 - a0 * y1 - a1 * y2 ; \
+      x2 = x1; x1 = x; y2 = y1; y1 = y; \
+   } while( 0 )
+
+void processSecondOrderFilterBlock( const float *in, int stride, float *out, int count,
+   float *mem1, float *mem2, const float *a, const float *b )
+{
+   float b0 = b[0], b1 = b[1], b2 = b[2], a0 = a[0], a1 = a[1];
+   float x11 = mem1[0], x12 = mem1[1], y11 = mem1[2], y12 = mem1[3];
+   float x21 = mem2[0], x22 = mem2[1], y21 = mem2[2], y22 = mem2[3];
+   for( int i=0; i<count; ++i, in += stride ) {
+      float x = *in, y, z;
+      BIQUAD_STEP( x, y, x11, x12, y11, y12, b0, b1, b2, a0, a1 );
+      BIQUAD_STEP( y, z, x21, x22, y21, y22, b0, b1, b2, a0, a1 );
+      out[i] = z;
+   }
+   mem1[0] = x11; mem1[1] = x12; mem1[2] = y11; mem1[3] = y12;
+   mem2[0] = x21; mem2[1] = x22; mem2[2] = y21; mem2[3] = y22;
+}
+
+void processSecondOrderFilterWindowBlock( const float *in, int stride, float *out, float *windowed,
+   const float *window, int count, float *mem1, float *mem2, const float *a, const float *b )
+{
+   float b0 = b[0], b1 = b[1], b2 = b[2], a0 = a[0], a1 = a[1];
+   float x11 = mem1[0], x12 = mem1[1], y11 = mem1[2], y12 = mem1[3];
+   float x21 = mem2[0], x22 = mem2[1], y21 = mem2[2], y22 = mem2[3];
+   for( int i=0; i<count; ++i, in += stride ) {
+      float x = *in, y, z;
+      BIQUAD_STEP( x, y, x11, x12, y11, y12, b0, b1, b2, a0, a1 );
+      BIQUAD_STEP( y, z, x21, x22, y21, y22, b0, b1, b2, a0, a1 );
+      out[i] = z;
+      windowed[i] = z * window[i];
+   }
+   mem1[0] = x11; mem1[1] = x12; mem1[2] = y11; mem1[3] = y12;
+   mem2[0] = x21; mem2[1] = x22; mem2[2] = y21; mem2[3] = y22;
+}
+
+#if defined( __GNUC__ )
+//GCC and clang turn this into SSE on x86 and NEON on ARM
+typedef float v4sf __attribute__(( vector_size( 16 ) ));
+
+void processSecondOrderFilterBlock4( const float *in, int stride, float *out[4], int count,
+   float *mem1[4], float *mem2[4], const float *a, const float *b )
+{
+   v4sf b0 = { b[0], b[0], b[0], b[0] }, b1 = { b[1], b[1], b[1], b[1] }, b2 = { b[2], b[2], b[2], b[2] };
+   v4sf a0 = { a[0], a[0], a[0], a[0] }, a1 = { a[1], a[1], a[1], a[1] };
+   v4sf x11 = { mem1[0][0], mem1[1][0], mem1[2][0], mem1[3][0] };
+   v4sf x12 = { mem1[0][1], mem1[1][1], mem1[2][1], mem1[3][1] };
+   v4sf y11 = { mem1[0][2], mem1[1][2], mem1[2][2], mem1[3][2] };
+   v4sf y12 = { mem1[0][3], mem1[1][3], mem1[2][3], mem1[3][3] };
+   v4sf x21 = { mem2[0][0], mem2[1][0], mem2[2][0], mem2[3][0] };
+   v4sf x22 = { mem2[0][1], mem2[1][1], mem2[2][1], mem2[3][1] };
+   v4sf y21 = { mem2[0][2], mem2[1][2], mem2[2][2], mem2[3][2] };
+   v4sf y22 = { mem2[0][3], mem2[1][3], mem2[2][3], mem2[3][3] };
+   for( int i=0; i<count; ++i, in += stride ) {
+      v4sf x, y, z;
+      memcpy( &x, in, sizeof( x ) ); //the four channels are adjacent but not aligned
+      BIQUAD_STEP( x, y, x11, x12, y11, y12, b0, b1, b2, a0, a1 );
+      BIQUAD_STEP( y, z, x21, x22, y21, y22, b0, b1, b2, a0, a1 );
+      out[0][i] = z[0]; out[1][i] = z[1]; out[2][i] = z[2]; out[3][i] = z[3];
+   }
+   for( int k=0; k<4; ++k ) {
+      mem1[k][0] = x11[k]; mem1[k][1] = x12[k]; mem1[k][2] = y11[k]; mem1[k][3] = y12[k];
+      mem2[k][0] = x21[k]; mem2[k][1] = x22[k]; mem2[k][2] = y21[k]; mem2[k][3] = y22[k];
+   }
+}
+#else
+void processSecondOrderFilterBlock4( const float *in, int stride, float *out[4], int count,
+   float *mem1[4], float *mem2[4], const float *a, const float *b )
+{
+   for( int k=0; k<4; ++k )
+      processSecondOrderFilterBlock( in + k, stride, out[k], count, mem1[k], mem2[k], a, b );
+}
+#endif
+
+//Designs a Blackman windowed sinc with DECIMATOR_TAPS_PER_PHASE taps per output phase. The transition
+//band is about 5.5 / numTaps of the input rate wide, so the cutoff sits half of that below the new
+//Nyquist frequency and little aliases back into the band that is kept.
+void initDecimator( struct decimator *d, int factor )
+{
+   d->factor = factor;
+   d->numTaps = factor * DECIMATOR_TAPS_PER_PHASE;
+   float cutoff = .5 / factor - 5.5 / ( 2.0 * d->numTaps ); //in cycles per input sample
+   float sum = 0;
+   for( int i=0; i<d->numTaps; ++i ) {
+      float t = i - ( d->numTaps - 1 ) / 2.0;
+      float sinc = t == 0 ? 2 * cutoff : sin( 2 * M_PI * cutoff * t ) / ( M_PI * t );
+      float x = 2 * M_PI * i / ( d->numTaps - 1 );
+      d->taps[d->numTaps-1-i] = sinc * ( .42 - .5 * cos( x ) + .08 * cos( 2 * x ) );
+      sum += d->taps[d->numTaps-1-i];
+   }
+   for( int i=0; i<d->numTaps; ++i )
+      d->taps[i] /= sum; //unity gain at DC
+   resetDecimator( d );
+}
+
+void resetDecimator( struct decimator *d )
+{
+   d->phase = 0;
+   for( int i=0; i<d->numTaps-1; ++i )
+      d->history[i] = 0;
+}
+
+int decimate( struct decimator *d, const float *in, int count, float *out )
+{
+   int keep = d->numTaps - 1;
+   float *x = d->history;
+   memcpy( x + keep, in, count * sizeof( float ) );
+   int written = 0;
+   //the first output is due after factor - phase more inputs
+   for( int i = d->factor - d->phase - 1; i < count; i += d->factor ) {
+      const float *h = d->taps, *xs = x + i; //xs[0..numTaps) ends at input i
+      float s0 = 0, s1 = 0, s2 = 0, s3 = 0; //separate sums so the loop can use SIMD
+      for( int k=0; k<d->numTaps; k += 4 ) {
+         s0 += h[k] * xs[k];
+         s1 += h[k+1] * xs[k+1];
+         s2 += h[k+2] * xs[k+2];
+         s3 += h[k+3] * xs[k+3];
+      }
+      out[written++] = ( s0 + s1 ) + ( s2 + s3 );
+   }
+   d->phase = ( d->phase + count ) % d->factor;
+   memmove( x, x + count, keep * sizeof( float ) );
+   return written;
+}
+
+//Returns the index of the bin with the largest magnitude
+int findPeak( float * datar, float * datai, int bins ){
+   float maxVal = -1;
+   int maxIndex = -1;
+   for( int j=0; j<bins; ++j ) {
+      float v = datar[j] * datar[j] + datai[j] * datai[j] ;
+      if( v > maxVal ) {
+         maxVal = v;
+         maxIndex = j;
+      }
+   }
+   return maxIndex;
+}
+
+//Fits a parabola through the log magnitudes of the peak bin and its neighbours. The Hann window makes
+//a tone's peak close to a Gaussian, whose log is a parabola, so this is accurate to a few hundredths of
+//a bin and the bin size no longer limits how well cents are measured.
+float interpolatePeak( float * datar, float * datai, int bins, int index ){
+   if( index < 1 || index >= bins - 1 )
+      return 0;
+   float l = logf( datar[index-1] * datar[index-1] + datai[index-1] * datai[index-1] + TINY );
+   float c = logf( datar[index] * datar[index] + datai[index] * datai[index] + TINY );
+   float r = logf( datar[index+1] * datar[index+1] + datai[index+1] * datai[index+1] + TINY );
+   float d = l - 2 * c + r;
+   if( d >= 0 ) //flat or not a peak
+      return 0;
+   float delta = .5 * ( l - r ) / d;
+   return delta < -.5 ? -.5 : delta > .5 ? .5 : delta;
+}
+
+int parseNoteName( const char * name, int * midiNote )
+{
+   static const int steps[7] = { 9, 11, 0, 2, 4, 5, 7 }; //A to G, from C
+   char * end;
+   if( isdigit( (unsigned char) name[0] ) ) {
+      long n = strtol( name, &end, 10 );
+      *midiNote = (int) n;
+      return *end || n > 127;
+   }
+   char letter = toupper( (unsigned char) name[0] );
+   if( letter < 'A' || letter > 'G' ) return 1;
+   int note = steps[letter - 'A'];
+   ++name;
+   if( *name == '#' ) { ++note; ++name; }
+   else if( *name == 'b' ) { --note; ++name; }
+   if( !isdigit( (unsigned char) *name ) ) return 1;
+   long octave = strtol( name, &end, 10 );
+   if( *end || octave > 9 ) return 1;
+   *midiNote = NUMNOTES * ( (int) octave + 1 ) + note; //C4 is 60
+   return *midiNote < 0 || *midiNote > 127;
+}
+
+float frequencyToMidi( float freq ){
+   return A4_MIDI_NOTE + NUMNOTES * log2f( freq / A4_FREQUENCY );
+}
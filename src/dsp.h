@@ -0,0 +1,57 @@
+/* dsp.h - filter, window and note helpers shared by the tuner and the benchmarks */
+
+#ifndef DSP_H
+#define DSP_H
+
+#define NUMNOTES (12)
+#define A4_MIDI_NOTE (69)
+#define A4_FREQUENCY (440.0)
+#define MAX_DECIMATION (8)
+#define DECIMATOR_TAPS_PER_PHASE (32)
+#define DECIMATOR_BLOCK (256) //most input samples one decimate() call takes
+
+/* -- an FIR low pass that keeps one output in factor and only computes those -- */
+struct decimator {
+   int factor;
+   int numTaps;
+   int phase; //inputs taken since the last output
+   float taps[MAX_DECIMATION * DECIMATOR_TAPS_PER_PHASE]; //time reversed, so each output is a forward dot product
+   float history[MAX_DECIMATION * DECIMATOR_TAPS_PER_PHASE + DECIMATOR_BLOCK]; //last numTaps-1 inputs, then the new ones
+};
+
+extern char * NOTES[NUMNOTES];
+
+//window is one of tables.h's hanWindows
+void applyWindow( const float *window, float *ring, int start, float *data, int size );
+//Like applyWindow(), but for only the newest size samples of a ring of ringSize
+void applyRecentWindow( const float *window, const float *ring, int ringSize, int start, float *data, int size );
+//a must be of length 2, and b must be of length 3
+void computeSecondOrderLowPassParameters( float srate, float f, float *a, float *b );
+//mem must be of length 4.
+float processSecondOrderFilter( float x, float *mem, float *a, float *b );
+//Runs count samples, stride apart in in, through two cascaded sections sharing a and b, with state in
+//mem1 and mem2, and writes them to out. Gives the same results as two processSecondOrderFilter() calls
+//per sample, but keeps the state in registers for the whole block.
+void processSecondOrderFilterBlock( const float *in, int stride, float *out, int count,
+   float *mem1, float *mem2, const float *a, const float *b );
+//The same, but also writes each output times window to windowed, so the window costs no extra pass.
+void processSecondOrderFilterWindowBlock( const float *in, int stride, float *out, float *windowed,
+   const float *window, int count, float *mem1, float *mem2, const float *a, const float *b );
+//Filters four streams at once with SIMD. Stream k reads in[k], in[k+stride], ... and writes out[k], with
+//state in mem1[k] and mem2[k], so four adjacent channels of interleaved input go through together.
+void processSecondOrderFilterBlock4( const float *in, int stride, float *out[4], int count,
+   float *mem1[4], float *mem2[4], const float *a, const float *b );
+//factor must be between 1 and MAX_DECIMATION. The stop band starts at the new Nyquist frequency.
+void initDecimator( struct decimator *d, int factor );
+void resetDecimator( struct decimator *d );
+//Takes count (up to DECIMATOR_BLOCK) samples and writes every factor'th filtered one to out. Returns how many were written.
+int decimate( struct decimator *d, const float *in, int count, float *out );
+int findPeak( float * datar, float * datai, int bins );
+//Returns how far the true peak lies from bin index, between -.5 and .5 bins
+float interpolatePeak( float * datar, float * datai, int bins, int index );
+//Reads a note name such as A4, C#5 or Bb3, or a MIDI note number, into midiNote. Returns 0 on success.
+int parseNoteName( const char * name, int * midiNote );
+//Returns the MIDI note number of freq with a fractional part; A4 at 440 Hz is 69
+float frequencyToMidi( float freq );
+
+#endif
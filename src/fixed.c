@@ -0,0 +1,143 @@
+/* fixed.c - the filter, window, FFT and peak search in fixed point */
+
+#include "fixed.h"
+#include <string.h>
+#include <math.h>
+#include "tables.h"
+
+void initFixedFilter( struct fixedFilter * f, const float * a, const float * b ){
+   for( int i = 0; i < 2; ++i )
+      f->a[i] = (int32_t) lround( a[i] * ( 1 << FIXED_COEFF_BITS ) );
+   for( int i = 0; i < 3; ++i )
+      f->b[i] = (int32_t) lround( b[i] * ( 1 << FIXED_COEFF_BITS ) );
+   resetFixedFilter( f );
+}
+
+void resetFixedFilter( struct fixedFilter * f ){
+   memset( f->mem1, 0, sizeof( f->mem1 ) );
+   memset( f->mem2, 0, sizeof( f->mem2 ) );
+}
+
+//One section in Q27, with the products summed in 64 bits and rounded back
+#define FIXED_BIQUAD_STEP( x, y, x1, x2, y1, y2, b0, b1, b2, a0, a1 ) \
+   do { \
+      int64_t acc = (int64_t) b0 * x + (int64_t) b1 * x1 + (int64_t) b2 * x2 \
+                  - (int64_t) a0 * y1 - (int64_t) a1 * y2; \
+      y = (int32_t)( ( acc + ( (int64_t) 1 << ( FIXED_COEFF_BITS - 1 ) ) ) >> FIXED_COEFF_BITS ); \
+      x2 = x1; x1 = x; y2 = y1; y1 = y; \
+   } while( 0 )
+
+void processFixedFilterBlock( struct fixedFilter * f, const int16_t * in, int stride, int16_t * out, int count ){
+   const int shift = FIXED_FILTER_BITS - 15;
+   int32_t b0 = f->b[0], b1 = f->b[1], b2 = f->b[2], a0 = f->a[0], a1 = f->a[1];
+   int32_t x11 = f->mem1[0], x12 = f->mem1[1], y11 = f->mem1[2], y12 = f->mem1[3];
+   int32_t x21 = f->mem2[0], x22 = f->mem2[1], y21 = f->mem2[2], y22 = f->mem2[3];
+   for( int i = 0; i < count; ++i, in += stride ) {
+      int32_t x = (int32_t) *in * ( 1 << shift ), y, z;
+      FIXED_BIQUAD_STEP( x, y, x11, x12, y11, y12, b0, b1, b2, a0, a1 );
+      FIXED_BIQUAD_STEP( y, z, x21, x22, y21, y22, b0, b1, b2, a0, a1 );
+      z = ( z + ( 1 << ( shift - 1 ) ) ) >> shift;
+      out[i] = (int16_t)( z > INT16_MAX ? INT16_MAX : z < INT16_MIN ? INT16_MIN : z );
+   }
+   f->mem1[0] = x11; f->mem1[1] = x12; f->mem1[2] = y11; f->mem1[3] = y12;
+   f->mem2[0] = x21; f->mem2[1] = x22; f->mem2[2] = y21; f->mem2[3] = y22;
+}
+
+void applyFixedWindow( const int16_t * window, const int16_t * ring, int start, int32_t * data, int size ){
+   int first = size - start;
+   for( int i = 0; i < first; ++i )
+      data[i] = (int32_t) ring[start + i] * window[i] * 2;
+   for( int i = first; i < size; ++i )
+      data[i] = (int32_t) ring[i - first] * window[i] * 2;
+}
+
+int initFixedFft( struct fixedFft * fft, int size ){
+   if( size < 2 || size > MAX_TABLE_SIZE || ( size & ( size - 1 ) ) )
+      return 1;
+   fft->size = size;
+   fft->bits = 0;
+   while( ( 1 << fft->bits ) < size )
+      ++fft->bits;
+   return 0;
+}
+
+//Q31 product
+static inline int32_t mulQ31( int32_t a, int32_t b ){
+   return (int32_t)( ( (int64_t) a * b ) >> 31 );
+}
+
+//In-place radix 2 transform of 2^bits complex points, interleaved in z, halving at every stage so the
+//result is scaled by 1/n and never overflows
+static void fixedComplexFft( int32_t * z, int bits ){
+   int n = 1 << bits;
+   const uint16_t * bitReverse = fftBitReverses[bits];
+   for( int i = 1; i < n; ++i ) {
+      int j = bitReverse[i];
+      if( i < j ) {
+         int32_t t = z[2*i]; z[2*i] = z[2*j]; z[2*j] = t;
+         t = z[2*i+1]; z[2*i+1] = z[2*j+1]; z[2*j+1] = t;
+      }
+   }
+   for( int b = 1, len = 2; len <= n; ++b, len <<= 1 ) {
+      int half = len / 2;
+      const int32_t * cosines = fixedFftCosines[b], * sines = fixedFftSines[b];
+      for( int k = 0; k < half; ++k ) {
+         int32_t c = cosines[k], s = sines[k];
+         for( int i = k; i < n; i += len ) {
+            int32_t * a = z + 2 * i, * b = z + 2 * ( i + half );
+            //b times e^{-j 2 pi k / len}
+            int32_t tr = mulQ31( b[0], c ) + mulQ31( b[1], s );
+            int32_t ti = mulQ31( b[1], c ) - mulQ31( b[0], s );
+            int64_t ar = a[0], ai = a[1];
+            a[0] = (int32_t)( ( ar + tr ) >> 1 );
+            a[1] = (int32_t)( ( ai + ti ) >> 1 );
+            b[0] = (int32_t)( ( ar - tr ) >> 1 );
+            b[1] = (int32_t)( ( ai - ti ) >> 1 );
+         }
+      }
+   }
+}
+
+void applyFixedRealFft( struct fixedFft * fft, int32_t * data, int32_t * datar, int32_t * datai ){
+   int m = fft->size / 2;
+   const int32_t * cosines = fixedFftCosines[fft->bits], * sines = fixedFftSines[fft->bits];
+   //the even samples are the real parts and the odd ones the imaginary parts of m complex points
+   fixedComplexFft( data, fft->bits - 1 );
+   //unzip them into datar and datai, front to back so nothing is overwritten before it is read
+   for( int k = 0; k < m; ++k ) {
+      datai[k] = data[2*k+1];
+      datar[k] = data[2*k];
+   }
+   //then split the spectra of the even and odd samples apart, a bin and its mirror at a time
+   int32_t r0 = datar[0], i0 = datai[0];
+   datar[0] = (int32_t)( ( (int64_t) r0 + i0 ) >> 1 );
+   datai[0] = 0;
+   datar[m] = (int32_t)( ( (int64_t) r0 - i0 ) >> 1 );
+   datai[m] = 0;
+   for( int k = 1; k <= m / 2; ++k ) {
+      int32_t ar = datar[k], ai = datai[k], br = datar[m - k], bi = -datai[m - k]; //b is the conjugate
+      int32_t er = (int32_t)( ( (int64_t) ar + br ) >> 1 ), ei = (int32_t)( ( (int64_t) ai + bi ) >> 1 );
+      int32_t dr = (int32_t)( ( (int64_t) ar - br ) >> 1 ), di = (int32_t)( ( (int64_t) ai - bi ) >> 1 );
+      int32_t c = cosines[k], s = sines[k];
+      //-j e^{-j 2 pi k / size} times d
+      int32_t tr = mulQ31( di, c ) - mulQ31( dr, s );
+      int32_t ti = -mulQ31( dr, c ) - mulQ31( di, s );
+      datar[k] = (int32_t)( ( (int64_t) er + tr ) >> 1 );
+      datai[k] = (int32_t)( ( (int64_t) ei + ti ) >> 1 );
+      datar[m - k] = (int32_t)( ( (int64_t) er - tr ) >> 1 );
+      datai[m - k] = (int32_t)( -( (int64_t) ei - ti ) >> 1 );
+   }
+}
+
+int findFixedPeak( const int32_t * datar, const int32_t * datai, int bins ){
+   uint64_t maxVal = 0;
+   int maxIndex = 0;
+   for( int j = 0; j < bins; ++j ) {
+      uint64_t v = (uint64_t)( (int64_t) datar[j] * datar[j] ) + (uint64_t)( (int64_t) datai[j] * datai[j] );
+      if( v > maxVal ) {
+         maxVal = v;
+         maxIndex = j;
+      }
+   }
+   return maxIndex;
+}
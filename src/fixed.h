@@ -0,0 +1,47 @@
+/* fixed.h - the filter, window, FFT and peak search in fixed point
+ *
+ * Small boards without much floating point throughput or memory bandwidth
+ * can take 16 bit samples straight from the sound card and keep them that
+ * way.  Samples and the Hann window are Q15, half the size of floats; the
+ * low pass keeps its state in Q27 with 64 bit products, so the poles near
+ * the unit circle at high sample rates don't lose it; the FFT works in Q31
+ * so a quiet voice still has bits to spare after every stage has halved
+ * it.  Only the three bins around the peak are turned into floats, for the
+ * interpolation and the cents.
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+#define FIXED_FILTER_BITS (27) //fraction bits of the filter state, leaving headroom for overshoot
+#define FIXED_COEFF_BITS (28) //fraction bits of the filter coefficients, which reach 2 in size
+
+/* -- the low pass of processSecondOrderFilterBlock() in fixed point -- */
+struct fixedFilter {
+   int32_t a[2], b[3]; //Q28
+   int32_t mem1[4], mem2[4]; //x1, x2, y1, y2 of each section, Q27
+};
+
+/* -- a real FFT of size points: a complex FFT of size/2 and a split -- */
+struct fixedFft {
+   int size;
+   int bits; //log2 of size, which picks its tables
+};
+
+//Takes the coefficients computeSecondOrderLowPassParameters() gave and clears the state
+void initFixedFilter( struct fixedFilter * f, const float * a, const float * b );
+void resetFixedFilter( struct fixedFilter * f );
+//Runs count Q15 samples, stride apart in in, through both sections, and writes them to out
+void processFixedFilterBlock( struct fixedFilter * f, const int16_t * in, int stride, int16_t * out, int count );
+//applyWindow() for a Q15 ring and a window from fixedHanWindows; data gets Q31
+void applyFixedWindow( const int16_t * window, const int16_t * ring, int start, int32_t * data, int size );
+//Returns 0 on success, or 1 if size is not a power of two the tables cover
+int initFixedFft( struct fixedFft * fft, int size );
+//Transforms size Q31 samples in data, overwriting them. Bins 0..size/2 come back in datar and datai
+//(datar may be data), scaled by 1/size like applyrealfft().
+void applyFixedRealFft( struct fixedFft * fft, int32_t * data, int32_t * datar, int32_t * datai );
+int findFixedPeak( const int32_t * datar, const int32_t * datai, int bins );
+
+#endif
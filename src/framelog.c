@@ -0,0 +1,226 @@
+/* framelog.c - append-only binary log of every pitch frame, and replay */
+
+#include "framelog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//Writes all of size bytes, retrying short writes. Returns 0 on success.
+static int writeAll( int fd, const void * data, size_t size ){
+   const char * p = data;
+   while( size > 0 ) {
+      ssize_t n = write( fd, p, size );
+      if( n < 0 ) {
+         if( errno == EINTR ) continue;
+         return 1;
+      }
+      p += n;
+      size -= n;
+   }
+   return 0;
+}
+
+//Swaps buffers whenever the one being filled has records, and writes the full one with the lock
+//released, so logFrame() only ever waits for another thread's copy into the buffer
+static void * writerThread( void * arg ){
+   struct frameLog * log = arg;
+   pthread_mutex_lock( &log->lock );
+   while( log->count > 0 || !log->closing ) {
+      if( log->count < FRAME_LOG_FLUSH && !log->closing ) {
+         struct timespec until;
+         clock_gettime( CLOCK_REALTIME, &until );
+         until.tv_sec += 1;
+         pthread_cond_timedwait( &log->ready, &log->lock, &until );
+         if( log->count == 0 ) continue;
+      }
+      struct frameRecord * full = log->buffers[log->filling];
+      int count = log->count;
+      log->filling ^= 1;
+      log->count = 0;
+      pthread_mutex_unlock( &log->lock );
+      bool failed = writeAll( log->fd, full, count * sizeof( struct frameRecord ) ) != 0;
+      pthread_mutex_lock( &log->lock );
+      if( failed && !log->failed ) {
+         log->failed = true;
+         log->dropped += count;
+         perror( "frame log" );
+      }
+   }
+   pthread_mutex_unlock( &log->lock );
+   return NULL;
+}
+
+//Checks that an existing file is a log of this version, or starts a new one with a header. A record cut
+//short when a session crashed is cut off, so the records appended after it line up.
+static int checkHeader( const char * path, int fd ){
+   struct stat st;
+   struct frameLogHeader header;
+   if( fstat( fd, &st ) ) {
+      perror( path );
+      return 1;
+   }
+   if( st.st_size == 0 ) {
+      memset( &header, 0, sizeof( header ) );
+      memcpy( header.magic, FRAME_LOG_MAGIC, sizeof( header.magic ) );
+      header.version = FRAME_LOG_VERSION;
+      header.recordSize = sizeof( struct frameRecord );
+      if( writeAll( fd, &header, sizeof( header ) ) ) {
+         perror( path );
+         return 1;
+      }
+      return 0;
+   }
+   if( pread( fd, &header, sizeof( header ), 0 ) != sizeof( header )
+      || memcmp( header.magic, FRAME_LOG_MAGIC, sizeof( header.magic ) )
+      || header.version != FRAME_LOG_VERSION || header.recordSize != sizeof( struct frameRecord ) ) {
+      fprintf( stderr, "%s: not a frame log this version can append to\n", path );
+      return 1;
+   }
+   off_t partial = ( st.st_size - sizeof( header ) ) % sizeof( struct frameRecord );
+   if( partial ) {
+      if( ftruncate( fd, st.st_size - partial ) ) {
+         perror( path );
+         return 1;
+      }
+      fprintf( stderr, "%s: dropped the last %ld bytes, a frame cut short\n", path, (long) partial );
+   }
+   return 0;
+}
+
+int openFrameLog( struct frameLog * log, const char * path ){
+   memset( log, 0, sizeof( *log ) );
+   log->fd = open( path, O_RDWR | O_APPEND | O_CREAT, 0644 );
+   if( log->fd < 0 ) {
+      perror( path );
+      return 1;
+   }
+   if( checkHeader( path, log->fd ) ) {
+      close( log->fd );
+      return 1;
+   }
+   log->buffers[0] = malloc( 2 * FRAME_LOG_BUFFER * sizeof( struct frameRecord ) );
+   if( !log->buffers[0] ) {
+      fprintf( stderr, "Could not allocate for the frame log.\n" );
+      close( log->fd );
+      return 1;
+   }
+   log->buffers[1] = log->buffers[0] + FRAME_LOG_BUFFER;
+   pthread_mutex_init( &log->lock, NULL );
+   pthread_cond_init( &log->ready, NULL );
+   if( pthread_create( &log->writer, NULL, writerThread, log ) ) {
+      fprintf( stderr, "Could not start the frame log writer.\n" );
+      pthread_cond_destroy( &log->ready );
+      pthread_mutex_destroy( &log->lock );
+      free( log->buffers[0] );
+      close( log->fd );
+      return 1;
+   }
+   return 0;
+}
+
+void logFrame( struct frameLog * log, const struct frameRecord * record ){
+   pthread_mutex_lock( &log->lock );
+   if( log->count == FRAME_LOG_BUFFER || log->failed ) {
+      log->dropped++; //the writer is a whole buffer behind; losing a frame beats stalling the analysis
+   } else {
+      log->buffers[log->filling][log->count++] = *record;
+      if( log->count == FRAME_LOG_FLUSH )
+         pthread_cond_signal( &log->ready );
+   }
+   pthread_mutex_unlock( &log->lock );
+}
+
+void closeFrameLog( struct frameLog * log ){
+   pthread_mutex_lock( &log->lock );
+   log->closing = true;
+   pthread_cond_signal( &log->ready );
+   pthread_mutex_unlock( &log->lock );
+   pthread_join( log->writer, NULL );
+   if( log->dropped )
+      fprintf( stderr, "Frame log: %lu frames could not be written\n", log->dropped );
+   pthread_cond_destroy( &log->ready );
+   pthread_mutex_destroy( &log->lock );
+   free( log->buffers[0] );
+   close( log->fd );
+}
+
+int16_t frameLevel( float amplitude ){
+   float level = amplitude > 0 ? 2000 * log10f( amplitude ) : INT16_MIN;
+   return level < INT16_MIN ? INT16_MIN : level > INT16_MAX ? INT16_MAX : (int16_t) lrintf( level );
+}
+
+int mapFrameLog( const char * path, struct frameLogMap * m ){
+   struct stat st;
+   memset( m, 0, sizeof( *m ) );
+   int fd = open( path, O_RDONLY );
+   if( fd < 0 || fstat( fd, &st ) ) {
+      perror( path );
+      if( fd >= 0 ) close( fd );
+      return 1;
+   }
+   if( st.st_size < (off_t) sizeof( struct frameLogHeader ) ) {
+      fprintf( stderr, "%s: not a frame log\n", path );
+      close( fd );
+      return 1;
+   }
+   m->mapSize = st.st_size;
+   m->map = mmap( NULL, m->mapSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd ); //the mapping keeps the file open
+   if( m->map == MAP_FAILED ) {
+      perror( path );
+      m->map = NULL;
+      return 1;
+   }
+   posix_madvise( m->map, m->mapSize, POSIX_MADV_SEQUENTIAL );
+
+   const struct frameLogHeader * header = m->map;
+   if( memcmp( header->magic, FRAME_LOG_MAGIC, sizeof( header->magic ) )
+      || header->version != FRAME_LOG_VERSION || header->recordSize != sizeof( struct frameRecord ) ) {
+      fprintf( stderr, "%s: not a frame log this version can read\n", path );
+      unmapFrameLog( m );
+      return 1;
+   }
+   m->records = (const struct frameRecord *)( header + 1 );
+   //a record cut short by a crash while writing is left out
+   m->count = ( m->mapSize - sizeof( *header ) ) / sizeof( struct frameRecord );
+   return 0;
+}
+
+void unmapFrameLog( struct frameLogMap * m ){
+   if( m->map ) munmap( m->map, m->mapSize );
+   m->map = NULL;
+}
+
+//Channels of a multi-channel session are logged as each is analyzed, so records are not in time order
+//across channels and every record is checked against the span
+size_t scoreFrames( const struct frameRecord * records, size_t count, int64_t from, int64_t to,
+   struct scoreCard * cards, struct noteTracker * trackers, int numCards ){
+   size_t scored = 0;
+   for( size_t i = 0; i < count; ++i ) {
+      const struct frameRecord * r = &records[i];
+      int c = r->channel & FRAME_LOG_CHANNEL_MASK;
+      if( c >= numCards ) continue;
+      if( r->channel & FRAME_LOG_FIRST ) { //the last session's final note ended with it
+         finishNote( &cards[c], &trackers[c] );
+         initNoteTracker( &trackers[c] );
+      }
+      if( r->time < from || r->time >= to ) continue;
+      cards[c].numInputs++;
+      updateInfo( &cards[c], r->midiNote, r->centsSharp );
+      trackNote( &cards[c], &trackers[c], r->time, r->midiNote, r->centsSharp, r->channel & FRAME_LOG_ONSET );
+      ++scored;
+   }
+   return scored;
+}
+
+size_t replayFrameLog( const struct frameLogMap * m, int64_t from, int64_t to, struct scoreCard * cards,
+   struct noteTracker * trackers, int numCards ){
+   return scoreFrames( m->records, m->count, from, to, cards, trackers, numCards );
+}
@@ -0,0 +1,96 @@
+/* framelog.h - append-only binary log of every pitch frame, and replay
+ *
+ * Every frame analyzeHop() scores becomes one 16 byte record, so a log
+ * holds everything needed to score a session again without the audio:
+ * replaying a month of practice is a pass over memory instead of hours of
+ * filtering and FFTs.  Analysis threads only copy a record into a buffer
+ * under a short lock; a writer thread of its own does the file I/O, so a
+ * slow disk never holds up the analysis.  Sessions are appended to the
+ * same file, and any number of logs can be replayed together over any
+ * span of time.  Records are in the byte order of the machine that wrote
+ * them.
+ */
+
+#ifndef FRAMELOG_H
+#define FRAMELOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "stats.h"
+
+#define FRAME_LOG_MAGIC "DINOPLOG"
+#define FRAME_LOG_VERSION (1)
+#define FRAME_LOG_BUFFER (16384) //records each of the two buffers holds
+#define FRAME_LOG_FLUSH (1024) //records that wake the writer early; otherwise it writes once a second
+#define FRAME_LOG_CHANNELS (64) //channels a replay keeps apart
+#define FRAME_LOG_FIRST (0x80) //set in a record's channel on the channel's first frame of a session
+#define FRAME_LOG_ONSET (0x40) //set in a record's channel when a new note event starts with the frame
+#define FRAME_LOG_CHANNEL_MASK (0x3f)
+#define FRAME_LOG_NO_LIMIT (INT64_MAX) //for a replay with no end; INT64_MIN for no start
+
+/* -- first 16 bytes of a log -- */
+struct frameLogHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t recordSize;
+};
+
+/* -- one scored frame -- */
+struct frameRecord {
+   int64_t time; //microseconds since the Unix epoch of the end of the frame
+   float centsSharp;
+   int16_t level; //of the peak, in hundredths of a dB relative to a full scale sine
+   uint8_t midiNote; //the nearest note
+   uint8_t channel; //with FRAME_LOG_FIRST set if it starts a session, so no interval spans two, and
+                    //FRAME_LOG_ONSET if a note starts with it
+};
+
+/* -- an open log being written -- */
+struct frameLog {
+   int fd;
+   pthread_t writer;
+   pthread_mutex_t lock;
+   pthread_cond_t ready; //signalled when a buffer is worth writing, or on close
+   struct frameRecord * buffers[2]; //analysis threads fill one while the writer writes the other
+   int filling;
+   int count; //records in buffers[filling]
+   bool closing;
+   bool failed; //a write failed; later records are dropped
+   unsigned long dropped; //records lost because the writer fell behind or failed
+};
+
+/* -- a log mapped for replay -- */
+struct frameLogMap {
+   void * map;
+   size_t mapSize;
+   const struct frameRecord * records;
+   size_t count;
+};
+
+//Opens path for appending, creating it if needed, and starts the writer. A partial record at the end, left
+//by a session that crashed mid-write, is cut off first. Returns 0 on success; otherwise prints a message
+//and returns 1.
+int openFrameLog( struct frameLog * log, const char * path );
+//Queues a record without waiting for the disk. Safe to call from any thread.
+void logFrame( struct frameLog * log, const struct frameRecord * record );
+//Writes what is queued, stops the writer and closes the file. Reports any records lost.
+void closeFrameLog( struct frameLog * log );
+//Converts a peak amplitude, 1 for a full scale sine, to a record's level
+int16_t frameLevel( float amplitude );
+
+//Maps a log written by openFrameLog(). Returns 0 on success; otherwise prints a message and returns 1.
+int mapFrameLog( const char * path, struct frameLogMap * m );
+void unmapFrameLog( struct frameLogMap * m );
+//Scores the records of m from time from up to but not including to into cards[channel], exactly as they
+//were scored live. Channels at or above numCards are skipped. trackers (one per card, set up with
+//initNoteTracker()) carry each channel's note events from one call to the next; finishNote() scores the
+//last ones. Returns the number of records scored.
+size_t replayFrameLog( const struct frameLogMap * m, int64_t from, int64_t to, struct scoreCard * cards,
+   struct noteTracker * trackers, int numCards );
+//Scores count records the same way, wherever they came from
+size_t scoreFrames( const struct frameRecord * records, size_t count, int64_t from, int64_t to,
+   struct scoreCard * cards, struct noteTracker * trackers, int numCards );
+
+#endif
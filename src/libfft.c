@@ -10,103 +10,59 @@
  * implied warranty.
  *
  * minor midifications July 2012 Bjorn Roche
+ * twiddle tables and real-input transform added to the plan
+ * tables generated at build time, shared by every plan
  */
 
 #ifndef __LIBFFT_C_
 
+#include <stddef.h>
 #include "libfft.h"
-#include <stdlib.h>
-#include <stdio.h>
-#include <math.h>
-
-#define MAXFFTSIZE 32768
-#define LOG2_MAXFFTSIZE 15
+#include "tables.h"
 
 struct fft_s {
-   int bitreverse[MAXFFTSIZE];
    int bits;
 } ;
 
+/* The bit reversals and twiddles come from tables.h, built with the
+ * program, so a plan is just its size: one for each size, shared by every
+ * caller on any thread, with nothing to set up or free. */
+static const struct fft_s plans[LOG2_MAX_TABLE_SIZE + 1] = {
+   { 0 }, { 1 }, { 2 }, { 3 }, { 4 }, { 5 }, { 6 }, { 7 }, { 8 },
+   { 9 }, { 10 }, { 11 }, { 12 }, { 13 }, { 14 }, { 15 }, { 16 }
+};
+
 /* initfft - initialize for fast Fourier transform
  *
  * b    power of two such that 2**nu = number of samples
+ *
+ * Returns the plan for that size, or NULL if b is out of range.
  */
 void *initfft( int b ) {
-    int i, j, k;
-    struct fft_s *fft;
-
-    fft = (struct fft_s *) malloc( sizeof( struct fft_s ) );
-    if( !fft ) {
-        fprintf( stderr, "Could not allocate for FFT.\n" );
-        exit(1);
-    }
-
-    fft->bits = b;
-    if ( fft->bits > LOG2_MAXFFTSIZE ) {
-        fprintf( stderr, "%d is too many bits, max is %d\n", fft->bits, LOG2_MAXFFTSIZE );
-        exit( 1 );
-    }
-
-    for ( i = ( 1 << fft->bits ) - 1; i >= 0; --i ) {
-        k = 0;
-        for ( j = 0; j < fft->bits; ++j ) {
-            k *= 2;
-            if ( i & ( 1 << j ) )
-                k += 1;
-            }
-        fft->bitreverse[i] = k;
-    }
-    return fft;
+    if ( b > LOG2_MAX_TABLE_SIZE || b < 1 )
+        return NULL;
+    return (void *) &plans[b];
 }
 
+/* destroyfft - give up a plan from initfft; the plans are never freed */
 void destroyfft( void *fft ) {
-    free( fft );
 }
 
-/* applyfft - a fast Fourier transform routine
+/* transform - unscaled in-place radix-2 transform of 2**bits points
  *
- * xr   real part of data to be transformed
- * xi   imaginary part (normally zero, unless inverse transform in effect)
- * inv  flag for inverse
+ * The stage combining spectra of len points reads the twiddles of a
+ * len point transform, so each stage reads its table in order.
  */
+static void transform( float *xr, float *xi, int bits, bool inv ) {
+    int n, i, j, k, b, len, half;
+    float c, s, tr, ti;
+    const uint16_t *bitreverse = fftBitReverses[bits];
+    const float *costable, *sintable;
 
-void applyfft( void * fft, float *xr, float *xi, bool inv ) {
-    int n, n2, i, k, kn2, l, p;
-    float ang, s, c, tr, ti;
-    //double ds, dc;
-    struct fft_s *mfft = (struct fft_s *) fft ;
-
-    n = 1 << mfft->bits;
-    n2 = n / 2;
-
-    for ( l = 0; l < mfft->bits; ++l ) {
-        for ( k = 0; k < n; k += n2 ) {
-            for( i = 0; i < n2; ++i, ++k ) {
-                p = mfft->bitreverse[k / n2];
-                ang = 6.283185 * p / n;
-                c = cos( ang );
-                s = sin( ang );
-/*
-                sincos( ang, &ds, &dc );
-                s = ds;
-                c = dc;
-*/
-                kn2 = k + n2;
-                if ( inv )
-                    s = -s;
-                tr = xr[kn2] * c + xi[kn2] * s;
-                ti = xi[kn2] * c - xr[kn2] * s;
-                xr[kn2] = xr[k] - tr;
-                xi[kn2] = xi[k] - ti;
-                xr[k] += tr;
-                xi[k] += ti;
-            }
-        }
-        n2 /= 2;
-    }
+    n = 1 << bits;
 
     for ( k = 0; k < n; ++k ) {
-        i = mfft->bitreverse[k];
+        i = bitreverse[k];
         if ( i <= k )
             continue;
         tr = xr[k];
@@ -117,6 +73,42 @@ void applyfft( void * fft, float *xr, float *xi, bool inv ) {
         xi[i] = ti;
     }
 
+    for ( b = 1, len = 2; len <= n; ++b, len *= 2 ) {
+        half = len / 2;
+        costable = fftCosines[b];
+        sintable = fftSines[b];
+        for ( k = 0; k < n; k += len ) {
+            for ( j = 0; j < half; ++j ) {
+                c = costable[j];
+                s = sintable[j];
+                if ( inv )
+                    s = -s;
+                i = k + j + half;
+                tr = xr[i] * c + xi[i] * s;
+                ti = xi[i] * c - xr[i] * s;
+                xr[i] = xr[k + j] - tr;
+                xi[i] = xi[k + j] - ti;
+                xr[k + j] += tr;
+                xi[k + j] += ti;
+            }
+        }
+    }
+}
+
+/* applyfft - a fast Fourier transform routine
+ *
+ * xr   real part of data to be transformed
+ * xi   imaginary part (normally zero, unless inverse transform in effect)
+ * inv  flag for inverse
+ */
+
+void applyfft( void * fft, float *xr, float *xi, bool inv ) {
+    int n, i;
+    const struct fft_s *mfft = (const struct fft_s *) fft ;
+
+    n = 1 << mfft->bits;
+    transform( xr, xi, mfft->bits, inv );
+
     /* Finally, multiply each value by 1/n, if this is the forward transform. */
     if ( ! inv ) {
         float f;
@@ -128,4 +120,62 @@ void applyfft( void * fft, float *xr, float *xi, bool inv ) {
         }
     }
 }
+
+/* applyrealfft - forward transform of real input
+ *
+ * x    n real samples
+ * xr   receives the real parts of bins 0..n/2 (n/2+1 values)
+ * xi   receives the imaginary parts of bins 0..n/2 (n/2+1 values)
+ *
+ * The even and odd samples are packed into one complex signal of n/2
+ * points, transformed, and then separated again.  Scaling matches
+ * applyfft.  xr may be the same buffer as x.
+ */
+void applyrealfft( void * fft, const float *x, float *xr, float *xi ) {
+    int n, m, k;
+    float ar, ai, br, bi, er, ei, orr, ori, tr, ti, c, s, f;
+    const struct fft_s *mfft = (const struct fft_s *) fft ;
+    const float *costable = fftCosines[mfft->bits], *sintable = fftSines[mfft->bits];
+
+    n = 1 << mfft->bits;
+    m = n / 2;
+
+    for ( k = 0; k < m; ++k ) {
+        ar = x[2 * k];
+        ai = x[2 * k + 1];
+        xr[k] = ar;
+        xi[k] = ai;
+    }
+    transform( xr, xi, mfft->bits - 1, false );
+
+    f = 1.0 / n;
+    ar = xr[0];
+    ai = xi[0];
+    xr[0] = ( ar + ai ) * f;
+    xi[0] = 0;
+    xr[m] = ( ar - ai ) * f;
+    xi[m] = 0;
+
+    /* bins k and m-k are built from the same pair of inputs, so they
+     * are produced together and the loop can run in place. */
+    f *= 0.5f;
+    for ( k = 1; k <= m / 2; ++k ) {
+        ar = xr[k];
+        ai = xi[k];
+        br = xr[m - k];
+        bi = -xi[m - k];
+        er = ( ar + br ) * f;
+        ei = ( ai + bi ) * f;
+        orr = ( ai - bi ) * f;
+        ori = ( br - ar ) * f;
+        c = costable[k];
+        s = sintable[k];
+        tr = c * orr + s * ori;
+        ti = c * ori - s * orr;
+        xr[k] = er + tr;
+        xi[k] = ei + ti;
+        xr[m - k] = er - tr;
+        xi[m - k] = ti - ei;
+    }
+}
 #endif // __LIBFFT_C_
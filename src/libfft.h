@@ -15,3 +15,4 @@
 void *initfft(int bits);
 void destroyfft( void *fft );
 void applyfft( void * fft, float *xr, float *xi, bool inv );
+void applyrealfft( void * fft, const float *x, float *xr, float *xi );
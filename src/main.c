@@ -16,341 +16,901 @@
 #include <string.h>
 #include <math.h>
 #include <signal.h>
-#include "libfft.h"
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "dinopitch.h"
+#include "audiofile.h"
+#include "dsp.h"
+#include "ringbuf.h"
+#include "metrics.h"
+#include "melody.h"
+#include "stats.h"
+#include "batch.h"
+#include "framelog.h"
+#include "display.h"
 #include <portaudio.h>
 
 /* -- some basic parameters -- */
-#define SAMPLE_RATE (8000)
-#define FFT_SIZE (8192)
-#define FFT_EXP_SIZE (13)
+#define CAPTURE_SECONDS (2) //of slack between the callback and the analysis
+#define CAPTURE_HOPS (4) //the ring holds at least this many hops: one being read, and room for callbacks of
+                         //the host's own size while it is
+#define MIN_SAMPLE_RATE (1000)
+#define MAX_SAMPLE_RATE (384000)
+#define DEFAULT_DISPLAY_RATE (30) //most frames drawn a second
+#define MIN_NOISE_FLOOR_DB (-200) //where only digital silence is quieter
+#define HEADLESS_INTERVAL (.1) //seconds between checks for the end of a headless session
+#define BAR_WIDTH (30) //characters either side of the note for 30 cents off
+#define IN_TUNE_CENTS (2) //about half an 8192-point bin at A4, which is what "in tune" used to mean
+#define MAX_CHANNELS (DINO_PITCH_MAX_CHANNELS)
 #define NUM_SECONDS (20)
-#define LOW_PASS_FILTER_PARAM (330)
-#define SCORETOTAL (100)
-#define NUMNOTES (12)
-#define CENTS_SHARP_MULTIPLIER (1200)
-#define ACCURACY_THRESHOLD (10.0)
-#define MIN (1000000000.0)
-#define MISS_THRESHOLD (.5)
-#define NUMOCTAVES (8)
-#define OCTAVE_ONE_START (31.7855) //halfway between B0 and C1
-#define OCTAVE_EIGHT_END (8137.075) //halway between B8 and C9
+
+/* -- shared by the PortAudio callback and the analysis threads -- */
+struct capture {
+   struct ringBuffer ring; //interleaved frames; each analysis thread is one reader
+   int channels;
+   //only written by whichever thread reads the input; read once the stream has stopped
+   unsigned long overflows; //buffers PortAudio reported as having lost input
+   unsigned long underflows;
+   unsigned long droppedSamples; //samples that arrived while the ring was full
+};
+
+/* -- latest result, handed from the analysis thread to the display -- */
+struct pitchReading {
+   pthread_mutex_t lock;
+   unsigned long count; //bumped for every new reading
+   const char * nearestNoteName;
+   float centsSharp;
+   uint64_t captured; //monotonic nanoseconds when the hop it came from was read
+};
+
+/* -- what one thread of the analysis pool works on -- */
+struct analysisThreadArgs {
+   int worker; //this thread's number, which is also its ring reader
+   int numWorkers; //channels are split into numWorkers runs of adjacent channels, one per thread
+   int numChannels;
+   struct dinoPitch * p;
+   struct capture * cap; //live input, or
+   struct audioFile * af; //a recording
+   struct pitchReading * readings; //one per channel, live input only
+};
 
 /* -- functions declared and used here -- */
-void buildHanWindow( float *window, int size );
-void applyWindow( float *window, float *data, int size );
-//a must be of length 2, and b must be of length 3
-void computeSecondOrderLowPassParameters( float srate, float f, float *a, float *b );
-//mem must be of length 4.
-float processSecondOrderFilter( float x, float *mem, float *a, float *b );
 void signalHandler( int signum ) ;
 void waitForStart();
-void handleErrors(PaStream * stream, PaError err, void* ftt);
+void handleErrors(PaStream * stream, PaError err);
 void handleSignals();
-void initTables(float * mem1, float * mem2, float * freqTable, char** noteNameTable, float * notePitchTable);
-int initPortAudio(PaError * err, PaStreamParameters * inputParametersp, PaStream ** stream);
-void outputPitch(char* nearestNoteName, int nearestNoteDelta, float centsSharp);
-int listen(PaError * errp, PaStream * stream, float * data, float * mem1, float * mem2, float * a,
-   float * b, float * window, float * datai, float * freqTable, float * notePitchTable, 
-   char ** noteNameTable, void * fft, float * score, int * numAccuratep);
-void printResults(int numAccurate, float score, int numInputs);
-void initNotesPlayedArrays();
-void updateInfo(float * scorep, int * numAccuratep, int unOctavedNoteIndex, int * prevNoteIndex, float centsSharp, float freq);
-bool printIntervals();
-bool printNotes();
-int findNoteIndex(char * noteName);
-
-static bool running = true;
-static int playedNotes[NUMNOTES * NUMOCTAVES]; 
-static int missedNotes[NUMNOTES * NUMOCTAVES];
-static int playedIntervals[NUMNOTES * NUMOCTAVES][NUMNOTES * NUMOCTAVES]; 
-static int missedIntervals[NUMNOTES * NUMOCTAVES][NUMNOTES * NUMOCTAVES];
-static char * NOTES[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+int initPortAudio(PaError * err, PaStreamParameters * inputParametersp, PaStream ** stream, int sampleRate,
+   int hop, int channels, PaSampleFormat format, struct capture * cap);
+int captureCallback( const void * input, void * output, unsigned long frameCount,
+   const PaStreamCallbackTimeInfo * timeInfo, PaStreamCallbackFlags statusFlags, void * userData );
+void * captureThread( void * arg );
+void * fileThread( void * arg );
+int numCores();
+int poolSize( int numChannels );
+int startAnalysisThreads( void * (*routine)( void * ), struct analysisThreadArgs * args, pthread_t * threads,
+   struct analysisThreadArgs * threadArgs );
+void joinAnalysisThreads( pthread_t * threads, int numThreads );
+void threadChannels( struct analysisThreadArgs * args, int * first, int * end );
+void sleepSeconds( double seconds );
+void addReadMetrics(const struct metrics * m);
+void outputPitch(struct display * d, const char * nearestNoteName, float centsSharp);
+void outputEnsemble(struct display * d, struct pitchReading * readings, int numChannels);
+int listen(PaError * errp, PaStream * stream, struct dinoPitch * p, struct capture * cap, struct display * d);
+void listenThreaded(struct dinoPitch * p, int numChannels, struct capture * cap, struct display * d);
+int writeMetricsReport(const char * path, struct dinoPitch * p, struct capture * cap, double seconds);
+void printCaptureStats(struct capture * cap);
+void scoreFile(struct audioFile * af, struct dinoPitch * p, int numChannels);
+void printAllResults(struct dinoPitch * p, int numChannels);
+int64_t microsecondsNow();
+int parseTimeSpan(const char * span, int64_t * from, int64_t * to);
+int parseNoteRange(const char * range, int * low, int * high);
+int replayLogs(char ** paths, int numPaths, int64_t from, int64_t to);
+void usage(char * progName);
+
+static volatile bool running = true;
+static struct display display;
+static struct metrics displayMetrics; //display and latency times, which no channel owns
+static struct metrics readMetrics; //input read times and backlog, which the library doesn't see
+static pthread_mutex_t readMetricsLock = PTHREAD_MUTEX_INITIALIZER; //for threads adding theirs
+static struct melody melody; //with -m; every channel follows it until the program ends
 
 /* -- main function -- */
 int main( int argc, char **argv ) {
    PaStreamParameters inputParameters;
-   float a[2], b[3], mem1[4], mem2[4];
-   float data[FFT_SIZE], datai[FFT_SIZE], window[FFT_SIZE], freqTable[FFT_SIZE], notePitchTable[FFT_SIZE];
-   char * noteNameTable[FFT_SIZE]; 
-   void * fft = NULL;
+   struct dinoPitch * p = NULL;
    PaStream *stream = NULL;
    PaError err = 0;
-   int numAccurate = 0; 
-   float score = 0.;
-   initNotesPlayedArrays();
+   struct capture cap = { .overflows = 0, .underflows = 0, .droppedSamples = 0 };
+   bool blocking = false;
+   //the window and hop are worked out for the sample rate once it is known
+   struct dinoPitchOptions options;
+   defaultDinoPitchOptions(&options);
+   bool rateGiven = false;
+   char * fileName = NULL;
+   char * batchPath = NULL;
+   char * logPath = NULL;
+   char * metricsPath = NULL;
+   char * melodyPath = NULL;
+   uint64_t started;
+   struct frameLog log;
+   bool replay = false;
+   bool headless = false;
+   double displayRate = DEFAULT_DISPLAY_RATE;
+   int64_t from = INT64_MIN, to = FRAME_LOG_NO_LIMIT;
+   int rawFormat = AUDIO_INT16;
+   int opt;
+   while( (opt = getopt(argc, argv, "H:N:R:d:p:t:ig:m:f:F:Bc:b:l:rT:u:qj:")) != -1 ) {
+      switch( opt ) {
+      case 'H':
+         options.hop = atoi(optarg);
+         if( options.hop < 1 || options.hop > DINO_PITCH_MAX_WINDOW ) {
+            fprintf( stderr, "Hop size must be between 1 and %d samples\n", DINO_PITCH_MAX_WINDOW );
+            return 1;
+         }
+         break;
+      case 'N':
+         options.windowSize = atoi(optarg);
+         if( options.windowSize < DINO_PITCH_MIN_WINDOW || options.windowSize > DINO_PITCH_MAX_WINDOW
+            || ( options.windowSize & ( options.windowSize - 1 ) ) ) {
+            fprintf( stderr, "%s\n", dinoPitchError(DINO_PITCH_BAD_WINDOW) );
+            return 1;
+         }
+         break;
+      case 'R':
+         options.sampleRate = atoi(optarg);
+         if( options.sampleRate < MIN_SAMPLE_RATE || options.sampleRate > MAX_SAMPLE_RATE ) {
+            fprintf( stderr, "Sample rate must be between %d and %d Hz\n", MIN_SAMPLE_RATE, MAX_SAMPLE_RATE );
+            return 1;
+         }
+         rateGiven = true;
+         break;
+      case 'd':
+         options.decimation = atoi(optarg);
+         if( options.decimation != 1 && options.decimation != 2 && options.decimation != 4 && options.decimation != 8 ) {
+            fprintf( stderr, "%s\n", dinoPitchError(DINO_PITCH_BAD_DECIMATION) );
+            return 1;
+         }
+         break;
+      case 'p':
+         options.detector = optarg; //checked with the rest of the options
+         break;
+      case 't':
+         if( parseNoteRange(optarg, &options.lowNote, &options.highNote) ) {
+            fprintf( stderr, "Note range must be low:high, such as C3:C5 or 48:72\n" );
+            return 1;
+         }
+         break;
+      case 'i':
+         options.fixedPoint = true;
+         break;
+      case 'g':
+         options.noiseFloor = atof(optarg);
+         if( options.noiseFloor < MIN_NOISE_FLOOR_DB || options.noiseFloor > 0 ) {
+            fprintf( stderr, "Noise floor must be between %d and 0 dB\n", MIN_NOISE_FLOOR_DB );
+            return 1;
+         }
+         break;
+      case 'm':
+         melodyPath = optarg;
+         break;
+      case 'f':
+         fileName = optarg;
+         break;
+      case 'F':
+         if( !strcmp(optarg, "s16") ) {
+            rawFormat = AUDIO_INT16;
+         } else if( !strcmp(optarg, "f32") ) {
+            rawFormat = AUDIO_FLOAT32;
+         } else {
+            fprintf( stderr, "Raw format must be s16 or f32\n" );
+            return 1;
+         }
+         break;
+      case 'B':
+         blocking = true;
+         break;
+      case 'b':
+         batchPath = optarg;
+         break;
+      case 'l':
+         logPath = optarg;
+         break;
+      case 'r':
+         replay = true;
+         break;
+      case 'T':
+         if( parseTimeSpan(optarg, &from, &to) ) {
+            fprintf( stderr, "Time span must be start:end in seconds since 1970; either may be left out\n" );
+            return 1;
+         }
+         break;
+      case 'u':
+         displayRate = atof(optarg);
+         if( displayRate < 1 || displayRate > 1000 ) {
+            fprintf( stderr, "Display rate must be between 1 and 1000 frames a second\n" );
+            return 1;
+         }
+         break;
+      case 'q':
+         headless = true;
+         break;
+      case 'j':
+         metricsPath = optarg;
+         break;
+      case 'c':
+         options.channels = atoi(optarg);
+         if( options.channels < 1 || options.channels > MAX_CHANNELS ) {
+            fprintf( stderr, "%s\n", dinoPitchError(DINO_PITCH_BAD_CHANNELS) );
+            return 1;
+         }
+         break;
+      default:
+         usage(argv[0]);
+         return 1;
+      }
+   }
+   if( blocking && options.channels > 1 ) {
+      fprintf( stderr, "Blocking reads (-B) only support one channel\n" );
+      return 1;
+   }
+   if( options.fixedPoint && !blocking && !fileName && !batchPath ) {
+      fprintf( stderr, "16 bit capture (-i) reads the microphone with blocking reads (-B)\n" );
+      return 1;
+   }
+   if( melodyPath && ( replay || batchPath ) ) {
+      fprintf( stderr, "A melody (-m) can only be followed live or with -f\n" );
+      return 1;
+   }
+   if( replay ) { //score logged frames again instead of any audio
+      if( optind == argc ) {
+         usage(argv[0]);
+         return 1;
+      }
+      return replayLogs(argv + optind, argc - optind, from, to);
+   }
+   if( logPath && batchPath ) {
+      fprintf( stderr, "Frame logs (-l) are not written in batch mode\n" );
+      return 1;
+   }
+   if( options.channels > 1 && batchPath ) {
+      fprintf( stderr, "Batch mode (-b) scores the first channel of each recording; -c can't be used with it\n" );
+      return 1;
+   }
+   if( metricsPath && batchPath ) {
+      fprintf( stderr, "Timings (-j) are not kept in batch mode\n" );
+      return 1;
+   }
+   if( melodyPath ) {
+      if( loadMelody(melodyPath, &melody) ) return 1;
+      options.melody = &melody;
+   }
    handleSignals();
-   buildHanWindow( window, FFT_SIZE );
-   fft = initfft( FFT_EXP_SIZE );
-   computeSecondOrderLowPassParameters( SAMPLE_RATE, LOW_PASS_FILTER_PARAM, a, b );
-   initTables(mem1, mem2, freqTable, noteNameTable, notePitchTable);
-   int result = initPortAudio(&err, &inputParameters, &stream);
+
+   //recordings that say what rate they were made at are scored at that rate; -R is for raw ones
+   if( batchPath ) //score a whole set of recordings
+      return scoreBatch(batchPath, rawFormat, &options, numCores(), &running);
+
+   int error;
+   if( fileName ) { //score a recording instead of the microphone
+      struct audioFile af;
+      if( openAudioFile(fileName, rawFormat, &af) ) return 1;
+      if( af.sampleRate && rateGiven && af.sampleRate != options.sampleRate ) {
+         fprintf( stderr, "%s: sample rate is %d Hz, not %d\n", fileName, af.sampleRate, options.sampleRate );
+         closeAudioFile(&af);
+         return 1;
+      }
+      if( af.sampleRate ) options.sampleRate = af.sampleRate;
+      if( options.channels > af.channels ) {
+         fprintf( stderr, "%s: has only %d channel(s)\n", fileName, af.channels );
+         closeAudioFile(&af);
+         return 1;
+      }
+      if( ( error = createDinoPitch(&options, &p) ) ) {
+         fprintf( stderr, "%s\n", dinoPitchError(error) );
+         closeAudioFile(&af);
+         return 1;
+      }
+      if( logPath ) {
+         //a recording's frames are dated from when it was last written, which is about when it was made
+         struct stat st;
+         bool dated = stat(fileName, &st) == 0;
+         if( !dated ) perror(fileName);
+         if( !dated || openFrameLog(&log, logPath) ) {
+            destroyDinoPitch(p);
+            closeAudioFile(&af);
+            return 1;
+         }
+         logDinoPitch(p, &log, (int64_t) st.st_mtime * 1000000);
+      }
+      started = monotonicNanos();
+      scoreFile(&af, p, options.channels);
+      double seconds = ( monotonicNanos() - started ) * 1e-9;
+      closeAudioFile(&af);
+      finishDinoPitch(p);
+      if( logPath ) closeFrameLog(&log);
+      printAllResults(p, options.channels);
+      int failed = metricsPath && writeMetricsReport(metricsPath, p, NULL, seconds);
+      destroyDinoPitch(p);
+      return failed;
+   }
+
+   if( ( error = createDinoPitch(&options, &p) ) ) {
+      fprintf( stderr, "%s\n", dinoPitchError(error) );
+      return 1;
+   }
+   getDinoPitchOptions(p, &options); //for the hop it chose
+   if( logPath && openFrameLog(&log, logPath) ) {
+      destroyDinoPitch(p);
+      return 1;
+   }
+   cap.channels = options.channels;
+   //each analysis thread reads the ring, so it needs one reader per thread
+   int numWorkers = poolSize(options.channels);
+   //a hop can be longer than CAPTURE_SECONDS, and a ring that can't hold one would never be read
+   unsigned long ringFrames = (unsigned long) CAPTURE_SECONDS * options.sampleRate;
+   if( ringFrames < (unsigned long) CAPTURE_HOPS * options.hop ) ringFrames = (unsigned long) CAPTURE_HOPS * options.hop;
+   if( !blocking && initRingBuffer(&cap.ring, ringFrames * options.channels, numWorkers) ) {
+      fprintf( stderr, "Could not allocate for capture.\n" );
+      destroyDinoPitch(p);
+      return 1;
+   }
+   int result = initPortAudio(&err, &inputParameters, &stream, options.sampleRate, options.hop, options.channels,
+      options.fixedPoint ? paInt16 : paFloat32, blocking ? NULL : &cap);
    if(result) goto error; //If result is non-zero, something is wrong
-   waitForStart();
-   int numInputs = listen(&err, stream, data, mem1, mem2, a, b, window, datai, freqTable, notePitchTable,
-      noteNameTable, fft, &score, &numAccurate);
+   initDisplay(&display, displayRate, headless);
+   if( !headless ) waitForStart(); //nobody may be at a headless session's keyboard
+   err = Pa_StartStream( stream );
+   if( err != paNoError ) goto error;
+   if( logPath ) logDinoPitch(p, &log, microsecondsNow());
+   started = monotonicNanos();
+   if( blocking ) {
+      listen(&err, stream, p, &cap, &display);
+      if( err != paNoError ) goto error;
+   } else {
+      listenThreaded(p, options.channels, &cap, &display);
+   }
 
+   double seconds = ( monotonicNanos() - started ) * 1e-9;
    err = Pa_StopStream( stream );
    if( err != paNoError ) goto error;
+   if( logPath ) closeFrameLog(&log);
 
-   printResults(numAccurate, score, numInputs);
+   finishDinoPitch(p);
+   printAllResults(p, options.channels);
+   printCaptureStats(&cap);
+   int failed = metricsPath && writeMetricsReport(metricsPath, p, &cap, seconds);
 
    // cleanup
-   destroyfft( fft );
+   Pa_CloseStream( stream );
+   destroyDinoPitch(p);
+   destroyRingBuffer( &cap.ring );
    Pa_Terminate();
 
-   return 0;
+   return failed;
  error:
-   handleErrors(stream, err, fft);
+   handleErrors(stream, err);
+   if( logPath ) closeFrameLog(&log);
+   destroyDinoPitch(p);
+   destroyRingBuffer( &cap.ring );
    return 1;
 }
 
-//Finds the index of the note name in the note array
-int findNoteIndex(char * noteName){
-    for(int i = 0; i < NUMNOTES; i++){
-        if(noteName == NOTES[i]) return i;
-    }
-    return -1;
+//Prints the command line options
+void usage(char * progName){
+   struct dinoPitchOptions defaults;
+   defaultDinoPitchOptions(&defaults);
+   fprintf(stderr, "Usage: %s [-R rate] [-N size] [-H hop] [-d factor] [-p fft|yin|multi|bank] [-t low:high] [-i] [-g dB] [-m melody] [-c channels] [-B] [-f file | -b dir-or-list] [-F s16|f32] [-l log] [-u rate] [-q] [-j file]\n", progName);
+   fprintf(stderr, "       %s -r [-T start:end] log...\n", progName);
+   fprintf(stderr, "  -R rate  sample rate in Hz of the microphone or a raw recording (default %d)\n", defaults.sampleRate);
+   fprintf(stderr, "  -N size  analysis window in samples, a power of two from %d to %d (default about a second)\n",
+      DINO_PITCH_MIN_WINDOW, DINO_PITCH_MAX_WINDOW);
+   fprintf(stderr, "  -H hop   samples between pitch updates, at most the window (default 1/%d of it)\n",
+      DINO_PITCH_HOPS_PER_WINDOW);
+   fprintf(stderr, "  -d n     analyze at 1/n of the sample rate with an n times smaller FFT: 1, 2, 4 or 8 (default 1)\n");
+   fprintf(stderr, "  -p name  pitch detector: fft (peak of a one second spectrum, the default), yin (50 ms frames), multi (the shortest window that resolves the note)\n"
+                  "           or bank (sliding DFT bins for just the notes in -t's range)\n");
+   fprintf(stderr, "  -t range notes the bank detector listens for, as low:high (default C2:C6)\n");
+   fprintf(stderr, "  -i       take 16 bit input and analyze it in fixed point, with the fft detector (live only with -B)\n");
+   fprintf(stderr, "  -g dB    skip hops quieter than this, relative to a full scale sine (default %.0f; %d for only digital silence)\n",
+      defaults.noiseFloor, MIN_NOISE_FLOOR_DB);
+   fprintf(stderr, "  -m file  score against the notes of a melody, one \"note seconds\" a line, instead of the nearest note\n");
+   fprintf(stderr, "  -c n     score the first n input channels separately (default 1)\n");
+   fprintf(stderr, "  -B       read the microphone with blocking reads on one thread\n");
+   fprintf(stderr, "  -f file  score a WAV or raw PCM recording instead of the microphone\n");
+   fprintf(stderr, "  -b path  score every recording in a directory, or listed one per line in a file\n");
+   fprintf(stderr, "  -F fmt   sample format of a raw recording (default s16)\n");
+   fprintf(stderr, "  -l log   also append every scored frame to a frame log\n");
+   fprintf(stderr, "  -u rate  most display updates a second (default %d)\n", DEFAULT_DISPLAY_RATE);
+   fprintf(stderr, "  -q       headless: start listening at once, show nothing until the results\n");
+   fprintf(stderr, "  -j file  write how long each stage took, and input lost, as JSON (- for standard output)\n");
+   fprintf(stderr, "  -r       score the frames in one or more frame logs instead of any audio\n");
+   fprintf(stderr, "  -T span  with -r, only frames from start to end, in seconds since 1970\n");
+}
+
+//Writes how long each stage took, over every channel, and how often input was lost (cap is NULL for a
+//recording) as JSON to path, or to standard output if path is "-". Returns 0 on success.
+int writeMetricsReport(const char * path, struct dinoPitch * p, struct capture * cap, double seconds){
+   FILE * f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+   if( !f ) {
+      perror(path);
+      return 1;
+   }
+   struct metrics * total = malloc(sizeof(struct metrics));
+   if( !total ) {
+      fprintf( stderr, "Could not allocate for the timings.\n" );
+      if( f != stdout ) fclose(f);
+      return 1;
+   }
+   struct dinoPitchOptions options;
+   getDinoPitchOptions(p, &options);
+   *total = displayMetrics;
+   mergeMetrics(total, &readMetrics);
+   addDinoPitchMetrics(p, total);
+   int inputs = 0, notes = 0;
+   long long silentHops = 0;
+   for( int c = 0; c < options.channels; ++c ) {
+      struct dinoPitchScore score;
+      scoreDinoPitch(p, c, &score);
+      inputs += score.frames;
+      notes += score.notes;
+      silentHops += score.silentHops;
+   }
+   fprintf(f, "{\n");
+   fprintf(f, "  \"seconds\": %.3f,\n", seconds);
+   fprintf(f, "  \"channels\": %d,\n", options.channels);
+   fprintf(f, "  \"detector\": \"%s\",\n", options.detector);
+   fprintf(f, "  \"hop\": %d,\n", options.hop);
+   fprintf(f, "  \"decimation\": %d,\n", options.decimation);
+   fprintf(f, "  \"inputs\": %d,\n", inputs);
+   fprintf(f, "  \"notes\": %d,\n", notes);
+   fprintf(f, "  \"silent_hops\": %lld,\n", silentHops);
+   if( cap ) {
+      fprintf(f, "  \"overflows\": %lu,\n", cap->overflows);
+      fprintf(f, "  \"underflows\": %lu,\n", cap->underflows);
+      fprintf(f, "  \"dropped_samples\": %lu,\n", cap->droppedSamples);
+   }
+   writeMetricsJson(f, total, seconds);
+   fprintf(f, "}\n");
+   free(total);
+   if( f != stdout ) return fclose(f) != 0;
+   fflush(f);
+   return 0;
+}
+
+//Prints the pitch results of every channel, labelled by channel if there is more than one
+void printAllResults(struct dinoPitch * p, int numChannels){
+   for( int c = 0; c < numChannels; ++c ) {
+      if( numChannels > 1 ) printf("%s=== Channel %d ===\n", c ? "\n" : "", c + 1);
+      printDinoPitch(p, c);
+   }
+}
+
+//Adds a thread's input read times and backlog to readMetrics
+void addReadMetrics(const struct metrics * m){
+   pthread_mutex_lock(&readMetricsLock);
+   mergeMetrics(&readMetrics, m);
+   pthread_mutex_unlock(&readMetricsLock);
+}
+
+int64_t microsecondsNow(){
+   struct timespec ts;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-//Prints the names of the notes that the user missed more than a specified percentage of the time. Returns true
-//if there are no frequently missed notes.
-bool printNotes(){
-   bool perfect = true; //no missed notes
-   printf("Problem notes:\n");
-   for(int i = 0; i < NUMNOTES * NUMOCTAVES; i++){
-      if(playedNotes[i]){
-         float missed = (float) missedNotes[i] / playedNotes[i];
-         if(missed > MISS_THRESHOLD){
-            //print integer instead of float; integer is precise enough for this purpose
-            printf("%s%d (missed %d %% of the time)\n", NOTES[i % NUMNOTES], 
-               (i / NUMNOTES) + 1, (int)(missed * SCORETOTAL));
-            perfect = false;
-         } 
+//Reads start:end, in seconds since 1970, into from and to in microseconds. Either may be left out to
+//leave that end open. Returns 0 on success.
+int parseTimeSpan(const char * span, int64_t * from, int64_t * to){
+   char * end;
+   const char * colon = strchr(span, ':');
+   if( !colon ) return 1;
+   if( colon != span ) {
+      *from = (int64_t)( strtod(span, &end) * 1e6 );
+      if( end != colon ) return 1;
+   }
+   if( colon[1] ) {
+      *to = (int64_t)( strtod(colon + 1, &end) * 1e6 );
+      if( *end ) return 1;
+   }
+   return 0;
+}
+
+//Reads low:high, each a note name such as C#3 or a MIDI note number, into low and high. Returns 0 on
+//success.
+int parseNoteRange(const char * range, int * low, int * high){
+   char name[16];
+   const char * colon = strchr(range, ':');
+   if( !colon || colon == range || colon - range >= (int) sizeof(name) ) return 1;
+   memcpy(name, range, colon - range);
+   name[colon - range] = '\0';
+   return parseNoteName(name, low) || parseNoteName(colon + 1, high) || *low > *high;
+}
+
+//Scores every frame in the logs from from up to to and prints the results, by channel if frames from
+//more than one channel were logged. Returns 0 on success.
+int replayLogs(char ** paths, int numPaths, int64_t from, int64_t to){
+   struct scoreCard * cards = malloc(FRAME_LOG_CHANNELS * sizeof(struct scoreCard));
+   struct noteTracker trackers[FRAME_LOG_CHANNELS];
+   size_t scored = 0;
+   if( !cards ) {
+      fprintf( stderr, "Could not allocate for replay.\n" );
+      return 1;
+   }
+   for( int c = 0; c < FRAME_LOG_CHANNELS; ++c ) {
+      initScoreCard(&cards[c]);
+      initNoteTracker(&trackers[c]);
+   }
+   int result = 0;
+   for( int i = 0; i < numPaths && !result; ++i ) {
+      struct frameLogMap m;
+      result = mapFrameLog(paths[i], &m);
+      if( result ) break;
+      scored += replayFrameLog(&m, from, to, cards, trackers, FRAME_LOG_CHANNELS);
+      unmapFrameLog(&m);
+   }
+   if( !result ) {
+      int numChannels = 0;
+      for( int c = 0; c < FRAME_LOG_CHANNELS; ++c )
+         finishNote(&cards[c], &trackers[c]);
+      for( int c = 0; c < FRAME_LOG_CHANNELS; ++c )
+         if( cards[c].numInputs ) numChannels = c + 1;
+      printf("Replayed %zu frames from %d log(s)\n\n", scored, numPaths);
+      for( int c = 0; c < numChannels; ++c ) {
+         if( numChannels > 1 ) printf("%s=== Channel %d ===\n", c ? "\n" : "", c + 1);
+         printResults(&cards[c]);
       }
+      if( numChannels == 0 ) printResults(&cards[0]);
    }
-   return perfect;
+   for( int c = 0; c < FRAME_LOG_CHANNELS; ++c )
+      destroyScoreCard(&cards[c]);
+   free(cards);
+   return result;
 }
 
-//Prints the interval jumps that the user missed more than a specified percentage of the time. Returns true
-//if there are no frequently missed intervals.
-bool printIntervals(){
-   bool perfect = true; //no missed intervals
-   printf("Problem intervals:\n");
-    for(int i = 0; i < NUMNOTES * NUMOCTAVES; i++){
-      for(int j = 0; j < NUMNOTES * NUMOCTAVES; j++){
-         if(playedIntervals[i][j]){
-            float missed = (float) missedIntervals[i][j] / playedIntervals[i][j];
-            if(missed > MISS_THRESHOLD){
-               //print integer instead of float; integer is precise enough for this purpose
-               printf("%s%d -> %s%d (missed %d %% of the time)\n", NOTES[i % NUMNOTES], 
-                  (i / NUMNOTES) + 1, NOTES[j % NUMNOTES], (j / NUMNOTES) + 1, (int)(missed * SCORETOTAL)); 
-               perfect = false;
-            } 
-         }
+//Listens to the microphone input and outputs the nearest pitch; returns number of inputs recorded.
+//A new pitch is computed every hop samples over the newest frame the pitch detector uses, and shown if
+//the display is due for a frame. Reading, analysis and display all happen on this thread, so a slow
+//display can make PortAudio drop input.
+int listen(PaError * errp, PaStream * stream, struct dinoPitch * p, struct capture * cap, struct display * d){
+   struct dinoPitchOptions options;
+   struct dinoPitchFrame frame;
+   struct dinoPitchScore score;
+   getDinoPitchOptions(p, &options);
+   void * input = malloc(options.hop * ( options.fixedPoint ? sizeof(int16_t) : sizeof(float) ));
+   if( !input ) {
+      fprintf( stderr, "Could not allocate for capture.\n" );
+      return 0;
+   }
+   while( running ) {
+      // read one hop of data
+      uint64_t t = monotonicNanos();
+      *errp = Pa_ReadStream( stream, input, options.hop );
+      if( *errp == paInputOverflowed ) {
+         cap->overflows++; //the samples we did get are still good
+         *errp = paNoError;
+      } else if( *errp != paNoError ) {
+         break;
+      }
+      uint64_t captured = recordStage(&readMetrics, STAGE_READ, t);
+      signed long backlog = Pa_GetStreamReadAvailable( stream );
+      if( backlog >= 0 ) recordValue(&readMetrics.backlog, backlog);
+      if( options.fixedPoint )
+         pushDinoPitch16(p, input, options.hop, 1);
+      else
+         pushDinoPitch(p, input, options.hop, 1);
+      if( pullDinoPitch(p, 0, &frame, 1) && displayDue(d) ) {
+         t = monotonicNanos();
+         outputPitch(d, dinoPitchNoteName(frame.midiNote), frame.centsSharp);
+         t = recordStage(&displayMetrics, STAGE_DISPLAY, t);
+         recordValue(&displayMetrics.stages[STAGE_LATENCY], t - captured);
       }
    }
-   return perfect;
+   free(input);
+   scoreDinoPitch(p, 0, &score);
+   return score.frames;
 }
 
-//Prints the pitch results of the recording: 
-void printResults(int numAccurate, float score, int numInputs){
-   if(numInputs == 0){ //ensures no division by 0 is attempted
-      printf("No inputs recorded. \n");
-   } else {
-      float percentAccurate = (((float) numAccurate)/numInputs) * SCORETOTAL;
-      printf("Percent accurate: %d %% \n", (int)percentAccurate); //print integer instead of float; integer is precise enough for this purpose
-      printf("\n");
-      printf("Precision Score: %d / 100 \n", (int)(score/numInputs)); //print integer instead of float; integer is precise enough for this purpose
+//Listens to the microphone through the capture callback. Analysis runs on a fixed pool of threads,
+//and this thread only draws the latest pitches, once a display frame, so a slow terminal delays the
+//display but never the input. A headless display leaves this thread waiting for the end.
+void listenThreaded(struct dinoPitch * p, int numChannels, struct capture * cap, struct display * d){
+   struct pitchReading readings[MAX_CHANNELS];
+   unsigned long shown[MAX_CHANNELS];
+   struct analysisThreadArgs args = { .numChannels = numChannels, .p = p, .cap = cap, .readings = readings };
+   struct analysisThreadArgs threadArgs[MAX_CHANNELS];
+   pthread_t threads[MAX_CHANNELS];
+   for( int c = 0; c < numChannels; ++c ) {
+      pthread_mutex_init(&readings[c].lock, NULL);
+      readings[c].count = 0;
+      shown[c] = 0;
    }
-   printf("\n");
-   if(printNotes()) printf("None! Nice job! :D \n"); //if this is true, it means the user didn't frequently miss any notes
-   printf("\n");
-   if(printIntervals()) printf("None! Nice job! :D \n"); //if this is true, it means the user didn't frequently miss any intervals
+   int numThreads = startAnalysisThreads(captureThread, &args, threads, threadArgs);
+   while( running && numThreads ) {
+      if( d->headless ) {
+         sleepSeconds(HEADLESS_INTERVAL);
+         continue;
+      }
+      bool fresh = false;
+      uint64_t captured[MAX_CHANNELS];
+      const char * nearestNoteName = NULL; //the first channel's, taken with its count so they match
+      float centsSharp = 0;
+      for( int c = 0; c < numChannels; ++c ) {
+         pthread_mutex_lock(&readings[c].lock);
+         captured[c] = readings[c].count != shown[c] ? readings[c].captured : 0;
+         fresh = fresh || readings[c].count != shown[c];
+         shown[c] = readings[c].count;
+         if( c == 0 ) {
+            nearestNoteName = readings[c].nearestNoteName;
+            centsSharp = readings[c].centsSharp;
+         }
+         pthread_mutex_unlock(&readings[c].lock);
+      }
+      if( fresh ) {
+         uint64_t t = monotonicNanos();
+         if( numChannels == 1 )
+            outputPitch(d, nearestNoteName, centsSharp);
+         else
+            outputEnsemble(d, readings, numChannels);
+         t = recordStage(&displayMetrics, STAGE_DISPLAY, t);
+         for( int c = 0; c < numChannels; ++c )
+            if( captured[c] ) recordValue(&displayMetrics.stages[STAGE_LATENCY], t - captured[c]);
+      }
+      sleepSeconds(d->interval);
+   }
+   joinAnalysisThreads(threads, numThreads);
+   for( int c = 0; c < numChannels; ++c )
+      pthread_mutex_destroy(&readings[c].lock);
+}
+
+int numCores(){
+   long cores = sysconf(_SC_NPROCESSORS_ONLN);
+   return cores < 1 ? 1 : (int) cores;
+}
+
+//Number of analysis threads for numChannels channels: one per channel, but no more than there are cores
+int poolSize( int numChannels ){
+   int cores = numCores();
+   return numChannels < cores ? numChannels : cores;
 }
 
-//Initializes the number of each note/interval played/missed to 0
-void initNotesPlayedArrays(){
-   for(int i = 0; i < NUMNOTES; i++){
-      playedNotes[i] = 0;
-      missedNotes[i] = 0;
-      for(int j = 0; j < NUMNOTES; j++){
-         playedIntervals[i][j] = 0;
-         missedIntervals[i][j] = 0;
+//Starts poolSize() threads running routine. Each gets its own copy of args in threadArgs, numbered so it
+//knows its share of the channels. Returns the number of threads that started.
+int startAnalysisThreads( void * (*routine)( void * ), struct analysisThreadArgs * args, pthread_t * threads,
+   struct analysisThreadArgs * threadArgs ){
+   int numWorkers = poolSize(args->numChannels);
+   for( int w = 0; w < numWorkers; ++w ) {
+      threadArgs[w] = *args;
+      threadArgs[w].worker = w;
+      threadArgs[w].numWorkers = numWorkers;
+      if( pthread_create(&threads[w], NULL, routine, &threadArgs[w]) ) {
+         fprintf( stderr, "Could not start an analysis thread.\n" );
+         running = false; //a missing thread would leave its channels unscored, so stop the others too
+         joinAnalysisThreads(threads, w);
+         return 0;
       }
    }
+   return numWorkers;
 }
 
-//Listens to the microphone input and outputs the nearest pitch; returns number of inputs recorded
-int listen(PaError * errp, PaStream * stream, float * data, float * mem1, float * mem2, float * a,
-   float * b, float * window, float * datai, float * freqTable, float * notePitchTable, 
-   char ** noteNameTable, void * fft, float * scorep, int * numAccuratep){
+void joinAnalysisThreads( pthread_t * threads, int numThreads ){
+   for( int w = 0; w < numThreads; ++w )
+      pthread_join(threads[w], NULL);
+}
+
+//Finds this thread's run of channels, [first, end). Adjacent channels sit next to each other in an
+//interleaved frame, so the library can filter four of them at once.
+void threadChannels( struct analysisThreadArgs * args, int * first, int * end ){
+   *first = args->worker * args->numChannels / args->numWorkers;
+   *end = ( args->worker + 1 ) * args->numChannels / args->numWorkers;
+}
 
-   int prevNoteIndex = -1; //Initialize the previous note index to -1 so it is not accessed on the first iteration
-   int numInputs = 0; //number of inputs recorded 
+//Consumes the capture ring one hop at a time for this thread's channels and publishes each pitch for
+//the display. The interleaved frames are pushed straight out of the ring.
+void * captureThread( void * arg ){
+   struct analysisThreadArgs * args = arg;
+   struct ringBuffer * ring = &args->cap->ring;
+   struct dinoPitchOptions options;
+   getDinoPitchOptions(args->p, &options);
+   int hop = options.hop;
+   int stride = args->numChannels;
+   unsigned long count = (unsigned long) hop * stride;
+   const float * data1, * data2;
+   unsigned long size1, size2;
+   struct dinoPitchFrame frame;
+   struct metrics metrics; //the thread's reads, timed once for all its channels
+   int first, end;
+   threadChannels(args, &first, &end);
+   clearMetrics(&metrics);
    while( running ) {
-      numInputs++;
-      // read some data
-      *errp = Pa_ReadStream( stream, data, FFT_SIZE );
-      for( int j=0; j<FFT_SIZE; ++j ) {
-         data[j] = processSecondOrderFilter( data[j], mem1, a, b );
-         data[j] = processSecondOrderFilter( data[j], mem2, a, b );
+      uint64_t t = monotonicNanos();
+      if( !ringBufferPeek(ring, args->worker, count, &data1, &size1, &data2, &size2) ) {
+         sleepSeconds( hop / (4.0 * options.sampleRate) ); //check a few times per hop
+         continue;
       }
-      applyWindow( window, data, FFT_SIZE );
-
-      // do the fft
-      for( int j=0; j<FFT_SIZE; ++j )
-         datai[j] = 0;
-      applyfft( fft, data, datai, false );
-
-      float maxVal = -1;
-      int maxIndex = -1;
-      for( int j=0; j<FFT_SIZE/2; ++j ) {
-         float v = data[j] * data[j] + datai[j] * datai[j] ;
-         if( v > maxVal ) {
-            maxVal = v;
-            maxIndex = j;
-         }
-      }      
-      float freq = freqTable[maxIndex];
-      //find the nearest note:
-      int nearestNoteDelta = 0;
-      while( true ) {
-         if( nearestNoteDelta < maxIndex && noteNameTable[maxIndex-nearestNoteDelta] != NULL ) {
-            nearestNoteDelta = -nearestNoteDelta;
-            break;
-         } else if( nearestNoteDelta + maxIndex < FFT_SIZE && noteNameTable[maxIndex+nearestNoteDelta] != NULL ) {
-            break;
+      uint64_t captured = recordStage(&metrics, STAGE_READ, t);
+      recordValue(&metrics.backlog, ( ringBufferReadAvailable(ring, args->worker) - count ) / stride);
+      //the ring holds whole frames, so a wrap never splits one
+      pushDinoPitchChannels(args->p, first, end - first, data1 + first, size1 / stride, stride);
+      pushDinoPitchChannels(args->p, first, end - first, data2 + first, size2 / stride, stride);
+      for( int c = first; c < end; ++c ) {
+         struct pitchReading * reading = &args->readings[c];
+         if( pullDinoPitch(args->p, c, &frame, 1) ) {
+            pthread_mutex_lock(&reading->lock);
+            reading->nearestNoteName = dinoPitchNoteName(frame.midiNote);
+            reading->centsSharp = frame.centsSharp;
+            reading->captured = captured;
+            reading->count++;
+            pthread_mutex_unlock(&reading->lock);
          }
-         ++(nearestNoteDelta);
       }
-      char * nearestNoteName = noteNameTable[maxIndex+nearestNoteDelta];
-      float nearestNotePitch = notePitchTable[maxIndex+nearestNoteDelta];
-      float centsSharp = CENTS_SHARP_MULTIPLIER * log( freq / nearestNotePitch ) / log( 2.0 );
-      int unOctavedNoteIndex = findNoteIndex(nearestNoteName);
-      updateInfo(scorep, numAccuratep, unOctavedNoteIndex, &prevNoteIndex, centsSharp, freq);
-      outputPitch(nearestNoteName, nearestNoteDelta, centsSharp);
-      
-   }
-   return numInputs;
+      ringBufferConsume(ring, args->worker, count);
+   }
+   addReadMetrics(&metrics);
+   return NULL;
+}
+
+//Runs on PortAudio's audio thread, so it only copies the input into the ring and counts problems
+int captureCallback( const void * input, void * output, unsigned long frameCount,
+   const PaStreamCallbackTimeInfo * timeInfo, PaStreamCallbackFlags statusFlags, void * userData ){
+   struct capture * cap = userData;
+   if( statusFlags & paInputOverflow ) cap->overflows++;
+   if( statusFlags & paInputUnderflow ) cap->underflows++;
+   if( input ) {
+      //only whole frames go in, so every thread stays lined up with its channels
+      unsigned long frames = ringBufferWriteAvailable(&cap->ring) / cap->channels;
+      if( frames > frameCount ) frames = frameCount;
+      ringBufferWrite(&cap->ring, input, frames * cap->channels);
+      cap->droppedSamples += ( frameCount - frames ) * cap->channels;
+   }
+   return paContinue;
 }
 
+//Prints how often input was lost while recording
+void printCaptureStats(struct capture * cap){
+   printf("\n");
+   printf("Input overflows: %lu, underflows: %lu, samples dropped: %lu\n",
+      cap->overflows, cap->underflows, cap->droppedSamples);
+}
 
-//updates accuracy/score/other pitch information based on frequency input
-void updateInfo(float * scorep, int * numAccuratep, int unOctavedNoteIndex, int * prevNoteIndexp, float centsSharp, float freq){
-   if(freq < OCTAVE_ONE_START || freq > OCTAVE_EIGHT_END) return; //return if outside of the span of the 8 octaves
-   int octave = (log(freq/OCTAVE_ONE_START)/log(2.0)) + 1; //converts from Hz to octave
-   int noteIndex = unOctavedNoteIndex + (octave * NUMNOTES); //puts note in respective octave
-   int prevNoteIndex = *prevNoteIndexp;
-   playedNotes[noteIndex]++;
-   if(prevNoteIndex > 0 && prevNoteIndex != noteIndex){ //if it's not the first note or the same note
-      playedIntervals[prevNoteIndex][noteIndex]++;
+void sleepSeconds( double seconds ){
+   struct timespec ts;
+   ts.tv_sec = (time_t) seconds;
+   ts.tv_nsec = (long)( ( seconds - ts.tv_sec ) * 1e9 );
+   nanosleep(&ts, NULL);
+}
+
+//Runs a whole recording through the pipeline as fast as it can be read, with each of the first numChannels
+//channels scored separately on the thread pool. A final partial hop is dropped.
+void scoreFile(struct audioFile * af, struct dinoPitch * p, int numChannels){
+   struct analysisThreadArgs args = { .numChannels = numChannels, .p = p, .af = af };
+   struct analysisThreadArgs threadArgs[MAX_CHANNELS];
+   pthread_t threads[MAX_CHANNELS];
+   joinAnalysisThreads(threads, startAnalysisThreads(fileThread, &args, threads, threadArgs));
+}
+
+//Scores this thread's channels of a recording, one channel at a time from start to end
+void * fileThread( void * arg ){
+   struct analysisThreadArgs * args = arg;
+   struct dinoPitchOptions options;
+   getDinoPitchOptions(args->p, &options);
+   int hop = options.hop;
+   struct dinoPitchFrame frame;
+   struct metrics metrics; //the thread's reads
+   void * input = malloc(hop * ( options.fixedPoint ? sizeof(int16_t) : sizeof(float) )); //one hop of a channel
+   int first, end;
+   threadChannels(args, &first, &end);
+   if( !input ) {
+      fprintf( stderr, "Could not allocate for analysis.\n" );
+      running = false; //its channels would go unscored
+      return NULL;
    }
-   if(fabsf(centsSharp) < ACCURACY_THRESHOLD){
-      (*numAccuratep)++; //Count it as an accurate pitch if it's "close enough" in the range of the accuracy threshold
-   } else {
-      missedNotes[noteIndex]++;
-      if(prevNoteIndex > 0 && prevNoteIndex != noteIndex){ //if it's not the first note or the same note
-         missedIntervals[prevNoteIndex][noteIndex]++;
+   clearMetrics(&metrics);
+   for( int c = first; c < end; ++c ) {
+      for( size_t start = 0; running && start + hop <= args->af->frames; start += hop ) {
+         uint64_t t = monotonicNanos();
+         if( options.fixedPoint ) {
+            readAudioFile16(args->af, start, c, input, hop);
+            recordStage(&metrics, STAGE_READ, t);
+            pushDinoPitchChannels16(args->p, c, 1, input, hop, 1);
+         } else {
+            readAudioFile(args->af, start, c, input, hop);
+            recordStage(&metrics, STAGE_READ, t);
+            pushDinoPitchChannels(args->p, c, 1, input, hop, 1);
+         }
+         while( pullDinoPitch(args->p, c, &frame, 1) ) ; //only the score is wanted
       }
    }
-   float singleInputScore = SCORETOTAL - fabsf(centsSharp);  
-   *scorep += singleInputScore;
-   *prevNoteIndexp = noteIndex;
+   addReadMetrics(&metrics);
+   free(input);
+   return NULL;
 }
 
 
-//Output the pitch heard and the degree of "pitchiness"
-void outputPitch(char* nearestNoteName, int nearestNoteDelta, float centsSharp){
-     printf("\033[2J\033[1;1H"); //clear screen, go to top left
-      fflush(stdout);
-      printf( "Ctrl+C for results. Nearest Note: %s\n", nearestNoteName );
-      if( nearestNoteDelta != 0 ) {
-         if( centsSharp > 0 )
-            printf( "%f cents sharp.\n", centsSharp );
-         if( centsSharp < 0 )
-            printf( "%f cents flat.\n", -centsSharp );
-      } else {
-         printf( "in tune!\n" );
-      }
-      printf( "\n" );
-      int chars = 30;
-      if( nearestNoteDelta == 0 || centsSharp >= 0 ) {
-         for( int i=0; i<chars; ++i )
-            printf( " " );
-      } else {
-         for( int i=0; i<chars+centsSharp; ++i )
-            printf( " " );
-         for( int i=chars+centsSharp<0?0:chars+centsSharp; i<chars; ++i )
-            printf( "=" );
-      }
-      printf( " %2s ", nearestNoteName );
-      if( nearestNoteDelta != 0 )
-         for( int i=0; i<chars && i<centsSharp; ++i )
-           printf( "=" );
-      printf("\n");
+//Output the pitch heard and the degree of "pitchiness": the note, with a bar of one character per cent
+//off on the side it is off
+void outputPitch(struct display * d, const char * nearestNoteName, float centsSharp){
+   bool inTune = fabsf(centsSharp) < IN_TUNE_CENTS;
+   char bar[2 * BAR_WIDTH + 8];
+   int off = inTune ? 0 : (int) ceilf(fabsf(centsSharp));
+   if( off > BAR_WIDTH ) off = BAR_WIDTH;
+   int flat = !inTune && centsSharp < 0 ? off : 0;
+   memset(bar, ' ', BAR_WIDTH - flat);
+   memset(bar + BAR_WIDTH - flat, '=', flat);
+   int len = BAR_WIDTH + sprintf(bar + BAR_WIDTH, " %2s ", nearestNoteName);
+   int sharp = !inTune && centsSharp > 0 ? off : 0;
+   memset(bar + len, '=', sharp);
+   bar[len + sharp] = '\0';
+
+   setDisplayLine(d, 0, "Ctrl+C for results. Nearest Note: %s", nearestNoteName);
+   if( inTune )
+      setDisplayLine(d, 1, "in tune!");
+   else
+      setDisplayLine(d, 1, "%f cents %s.", fabsf(centsSharp), centsSharp > 0 ? "sharp" : "flat");
+   setDisplayLine(d, 3, "%s", bar);
+   drawDisplay(d);
 }
 
-//Initializes PortAudio, which is what is used to gather input/pitches from the microphone.
+//Output one line per channel with its nearest note and how far off it is
+void outputEnsemble(struct display * d, struct pitchReading * readings, int numChannels){
+   setDisplayLine(d, 0, "Ctrl+C for results.");
+   for( int c = 0; c < numChannels; ++c ) {
+      pthread_mutex_lock(&readings[c].lock);
+      const char * nearestNoteName = readings[c].count ? readings[c].nearestNoteName : "-";
+      float centsSharp = readings[c].centsSharp;
+      pthread_mutex_unlock(&readings[c].lock);
+      if( fabsf(centsSharp) < IN_TUNE_CENTS )
+         setDisplayLine(d, c + 2, "Channel %2d: %-2s in tune!", c + 1, nearestNoteName);
+      else
+         setDisplayLine(d, c + 2, "Channel %2d: %-2s %6.1f cents %s", c + 1, nearestNoteName, fabsf(centsSharp),
+            centsSharp > 0 ? "sharp" : "flat");
+   }
+   drawDisplay(d);
+}
+
+//Initializes PortAudio, which is what is used to gather input/pitches from the microphone, and opens
+//the stream at sampleRate, once the device says it supports it. If cap is NULL the stream is read with
+//blocking reads; otherwise the capture callback feeds cap's ring and the lowest latency the device
+//offers is requested.
 //Returns 0 if initialization is successful; otherwise, returns 1
-int initPortAudio(PaError * err, PaStreamParameters * inputParametersp, PaStream ** stream){
+int initPortAudio(PaError * err, PaStreamParameters * inputParametersp, PaStream ** stream, int sampleRate,
+   int hop, int channels, PaSampleFormat format, struct capture * cap){
    *err = Pa_Initialize();
    int error = 1;
    if( *err != paNoError ) return error;
 
    inputParametersp->device = Pa_GetDefaultInputDevice();
-   inputParametersp->channelCount = 1;
-   inputParametersp->sampleFormat = paFloat32;
-   inputParametersp->suggestedLatency = Pa_GetDeviceInfo( inputParametersp->device )->defaultHighInputLatency ;
+   inputParametersp->channelCount = channels;
+   inputParametersp->sampleFormat = format;
+   if( cap )
+      inputParametersp->suggestedLatency = Pa_GetDeviceInfo( inputParametersp->device )->defaultLowInputLatency ;
+   else
+      inputParametersp->suggestedLatency = Pa_GetDeviceInfo( inputParametersp->device )->defaultHighInputLatency ;
    inputParametersp->hostApiSpecificStreamInfo = NULL;
 
    printf( "Opening %s\n",
            Pa_GetDeviceInfo( inputParametersp->device )->name );
 
+   *err = Pa_IsFormatSupported( inputParametersp, NULL, sampleRate );
+   if( *err != paFormatIsSupported ) {
+      fprintf( stderr, "%s can't record %d channel(s) at %d Hz (its default rate is %.0f Hz)\n",
+         Pa_GetDeviceInfo( inputParametersp->device )->name, channels, sampleRate,
+         Pa_GetDeviceInfo( inputParametersp->device )->defaultSampleRate );
+      return error;
+   }
    *err = Pa_OpenStream( stream,
                         inputParametersp,
                         NULL, //no output
-                        SAMPLE_RATE,
-                        FFT_SIZE,
+                        sampleRate,
+                        cap ? paFramesPerBufferUnspecified : hop, //let the host pick its smallest buffers
                         paClipOff,
-                        NULL,
-                        NULL );
-   if( *err != paNoError ) return error;
-
-   *err = Pa_StartStream( *stream );
+                        cap ? captureCallback : NULL,
+                        cap );
    if( *err != paNoError ) return error;
    return 0;
 }
 
-//Initialize values in frequency and note tables
-void initTables(float * mem1, float * mem2, float * freqTable, char** noteNameTable, float * notePitchTable){
-   mem1[0] = 0; mem1[1] = 0; mem1[2] = 0; mem1[3] = 0;
-   mem2[0] = 0; mem2[1] = 0; mem2[2] = 0; mem2[3] = 0;
-
-   for( int i=0; i<FFT_SIZE; ++i ) {
-      freqTable[i] = ( SAMPLE_RATE * i ) / (float) ( FFT_SIZE );
-   }
-   for( int i=0; i<FFT_SIZE; ++i ) {
-      noteNameTable[i] = NULL;
-      notePitchTable[i] = -1;
-   }
-   for( int i=0; i<127; ++i ) {
-      float pitch = ( 440.0 / 32.0 ) * pow( 2, (i-9.0)/12.0 ) ;
-      if( pitch > SAMPLE_RATE / 2.0 )
-         break;
-      //find the closest frequency using brute force.
-      float min = MIN;
-      int index = -1;
-      for( int j=0; j<FFT_SIZE; ++j ) {
-         if( fabsf( freqTable[j]-pitch ) < min ) {
-             min = fabsf( freqTable[j]-pitch );
-             index = j;
-         }
-      }
-      noteNameTable[index] = NOTES[i% NUMNOTES];
-      notePitchTable[index] = pitch;
-   }
-}
-
 //Set up signal handlers for correct exiting of program
 void handleSignals(){  
    struct sigaction action;
@@ -365,12 +925,11 @@ void handleSignals(){
 }
 
 //]s respective error messages if something goes wrong
-void handleErrors(PaStream * stream, PaError err, void * fft){
+void handleErrors(PaStream * stream, PaError err){
    if( stream ) {
       Pa_AbortStream( stream );
       Pa_CloseStream( stream );
    }
-   destroyfft( fft );
    Pa_Terminate();
    fprintf( stderr, "An error occured while using the portaudio stream\n" );
    fprintf( stderr, "Error number: %d\n", err );
@@ -386,51 +945,5 @@ void waitForStart(){
    }
 }
 
-//Creates window signal in order to reduce reading of frequencies that are not actually present
-void buildHanWindow( float *window, int size )
-{
-   for( int i=0; i<size; ++i )
-      window[i] = .5 * ( 1 - cos( 2 * M_PI * i / (size-1.0) ) );
-}
-
-//Multiplies audio input by window signal to reduce reading of frequencies that are not actually present
-void applyWindow( float *window, float *data, int size )
-{
-   for( int i=0; i<size; ++i )
-      data[i] *= window[i] ;
-}
-
-//Computes low pass parameters in order to filter out misleading higher frequencies
-void computeSecondOrderLowPassParameters( float srate, float f, float *a, float *b )
-{
-   float a0;
-   float w0 = 2 * M_PI * f/srate;
-   float cosw0 = cos(w0);
-   float sinw0 = sin(w0);
-   //float alpha = sinw0/2;
-   float alpha = sinw0/2 * sqrt(2);
-
-   a0   = 1 + alpha;
-   a[0] = (-2*cosw0) / a0;
-   a[1] = (1 - alpha) / a0;
-   b[0] = ((1-cosw0)/2) / a0;
-   b[1] = ( 1-cosw0) / a0;
-   b[2] = b[0];
-}
-
-//Applies the low pass filter to the audio to filter out misleading higher frequencies
-float processSecondOrderFilter( float x, float *mem, float *a, float *b )
-{
-    float ret = b[0] * x + b[1] * mem[0] + b[2] * mem[1]
-                         - a[0] * mem[2] - a[1] * mem[3] ;
-      mem[1] = mem[0];
-      mem[0] = x;
-      mem[3] = mem[2];
-      mem[2] = ret;
-
-      return ret;
-
-}
-
 //Stops the recording
 void signalHandler( int signum ) { running = false; }
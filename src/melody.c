@@ -0,0 +1,152 @@
+/* melody.c - a target melody, and following a singer through it as they sing */
+
+#include "melody.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dsp.h"
+
+int loadMelody( const char * path, struct melody * m ){
+   FILE * f = fopen( path, "r" );
+   char line[256];
+   int capacity = 0, lineNumber = 0;
+   memset( m, 0, sizeof( *m ) );
+   if( !f ) {
+      perror( path );
+      return 1;
+   }
+   while( fgets( line, sizeof( line ), f ) ) {
+      char name[16];
+      double seconds;
+      int n;
+      ++lineNumber;
+      line[strcspn( line, "#\r\n" )] = '\0';
+      if( sscanf( line, " %15s%n", name, &n ) != 1 ) continue; //blank
+      struct melodyNote note = { .midiNote = MELODY_REST };
+      bool rest = !strcmp( name, "R" ) || !strcmp( name, "r" );
+      if( sscanf( line + n, "%lf", &seconds ) != 1 || seconds <= 0
+         || ( !rest && parseNoteName( name, &note.midiNote ) ) ) {
+         fprintf( stderr, "%s:%d: expected a note and its length in seconds\n", path, lineNumber );
+         fclose( f );
+         freeMelody( m );
+         return 1;
+      }
+      note.seconds = seconds;
+      if( m->numNotes == capacity ) {
+         capacity = capacity ? capacity * 2 : 64;
+         struct melodyNote * notes = realloc( m->notes, capacity * sizeof( struct melodyNote ) );
+         if( !notes ) {
+            fprintf( stderr, "Could not allocate for the melody.\n" );
+            fclose( f );
+            freeMelody( m );
+            return 1;
+         }
+         m->notes = notes;
+      }
+      m->notes[m->numNotes++] = note;
+      m->seconds += seconds;
+   }
+   fclose( f );
+   if( m->numNotes == 0 ) {
+      fprintf( stderr, "%s: no notes\n", path );
+      return 1;
+   }
+   return 0;
+}
+
+void freeMelody( struct melody * m ){
+   free( m->notes );
+   m->notes = NULL;
+   m->numNotes = 0;
+}
+
+int initMelodyFollower( struct melodyFollower * f, const struct melody * m, double hopSeconds ){
+   double seconds = 0;
+   f->melody = m;
+   f->starts = malloc( ( m->numNotes + 1 ) * sizeof( long long ) );
+   f->cost = f->next = NULL;
+   if( !f->starts ) return 1;
+   for( int i = 0; i <= m->numNotes; ++i ) {
+      f->starts[i] = llround( seconds / hopSeconds );
+      if( i < m->numNotes ) seconds += m->notes[i].seconds;
+   }
+   f->length = f->starts[m->numNotes];
+   if( f->length == 0 ) f->length = f->starts[m->numNotes] = 1; //shorter than a hop, but still a melody
+   f->band = (int) ceil( MELODY_BAND_SECONDS / hopSeconds );
+   if( f->band > f->length ) f->band = (int) f->length;
+   f->cost = malloc( f->band * sizeof( double ) );
+   f->next = malloc( f->band * sizeof( double ) );
+   if( !f->cost || !f->next ) {
+      destroyMelodyFollower( f );
+      return 1;
+   }
+   resetMelodyFollower( f );
+   return 0;
+}
+
+void destroyMelodyFollower( struct melodyFollower * f ){
+   free( f->starts ); free( f->cost ); free( f->next );
+   f->starts = NULL;
+   f->cost = f->next = NULL;
+}
+
+void resetMelodyFollower( struct melodyFollower * f ){
+   f->lo = 0;
+   f->loNote = 0;
+   f->started = false;
+   f->position = 0;
+}
+
+//How badly a hop sung at midi matches a hop of the melody on note
+static double hopCost( int note, float midi, bool sounding ){
+   if( note == MELODY_REST ) return sounding ? MELODY_REST_COST : 0;
+   if( !sounding ) return MELODY_REST_COST;
+   double d = fabs( midi - note );
+   return d < MELODY_MAX_COST ? d : MELODY_MAX_COST;
+}
+
+int followMelody( struct melodyFollower * f, float midi, bool sounding ){
+   const struct melodyNote * notes = f->melody->notes;
+   int band = f->band;
+   //the band only moves forward, keeping the last match a quarter of the way in
+   long long lo = f->position - band / 4;
+   if( lo > f->length - band ) lo = f->length - band;
+   if( lo < f->lo ) lo = f->lo;
+   int shift = (int)( lo - f->lo );
+   while( f->starts[f->loNote + 1] <= lo )
+      ++f->loNote;
+
+   int note = f->loNote, bestNote = note;
+   double bestCost = INFINITY;
+   long long best = lo;
+   for( int k = 0; k < band; ++k ) {
+      long long j = lo + k;
+      while( f->starts[note + 1] <= j )
+         ++note;
+      double from; //the cheapest way here: the singer held on, moved on with the melody, or skipped ahead
+      if( !f->started ) {
+         from = k ? f->next[k - 1] : 0; //every path starts at the beginning of the melody
+      } else {
+         int p = k + shift; //this hop in the last frame's band
+         double held = p < band ? f->cost[p] : INFINITY;
+         double moved = p >= 1 && p - 1 < band ? f->cost[p - 1] : INFINITY;
+         double skipped = k ? f->next[k - 1] : INFINITY;
+         from = held < moved ? held : moved;
+         if( skipped < from ) from = skipped;
+      }
+      f->next[k] = from + hopCost( notes[note].midiNote, midi, sounding );
+      if( f->next[k] < bestCost ) {
+         bestCost = f->next[k];
+         best = j;
+         bestNote = note;
+      }
+   }
+   double * t = f->cost;
+   f->cost = f->next;
+   f->next = t;
+   f->lo = lo;
+   f->started = true;
+   f->position = best;
+   return notes[bestNote].midiNote;
+}
@@ -0,0 +1,65 @@
+/* melody.h - a target melody, and following a singer through it as they sing
+ *
+ * The nearest note only says how far a singer was from some note, not
+ * whether it was the right one.  Given the melody they are meant to sing,
+ * each frame is matched to the place in it the singer has reached, by
+ * dynamic time warping against the melody laid out a hop at a time, so
+ * singing slower, faster or starting late still lines up.  The warping is
+ * done online and inside a band that follows the best match: each frame
+ * updates one column of the cost matrix over the band and nothing more,
+ * so a frame takes the same time at the end of a ten minute piece as at
+ * the start, and only two columns are ever kept.
+ *
+ * A melody file has one note a line: a name such as A4, C#5 or Bb3 (or a
+ * MIDI note number, or R for a rest), then its length in seconds.
+ * Anything after a # is a comment.
+ */
+
+#ifndef MELODY_H
+#define MELODY_H
+
+#include <stdbool.h>
+
+#define MELODY_REST (-1)
+#define MELODY_BAND_SECONDS (8.0) //how far apart the singer and the melody's time may drift and be found again
+#define MELODY_MAX_COST (3.0) //semitones; a wrong note costs no more than this, so one bad note can't derail the path
+#define MELODY_REST_COST (2.0) //for singing through a rest, or silence where a note should be
+
+struct melodyNote {
+   int midiNote; //or MELODY_REST
+   double seconds;
+};
+
+struct melody {
+   struct melodyNote * notes;
+   int numNotes;
+   double seconds;
+};
+
+/* -- how far one channel has got through a melody -- */
+struct melodyFollower {
+   const struct melody * melody;
+   long long * starts; //the hop each note starts at, numNotes + 1 long
+   long long length; //hops in the whole melody
+   int band; //hops of the melody looked at for each frame
+   double * cost, * next; //accumulated cost of the best path to each hop in the band, now and for this frame
+   long long lo; //the hop of the melody cost[0] is for
+   int loNote; //the note that hop is in
+   bool started;
+   long long position; //the hop of the melody the last frame matched
+};
+
+//Reads a melody file. Returns 0 on success; otherwise prints a message and returns 1.
+int loadMelody( const char * path, struct melody * m );
+void freeMelody( struct melody * m );
+
+//Sets up to follow m one hop of hopSeconds at a time. Returns 0 on success.
+int initMelodyFollower( struct melodyFollower * f, const struct melody * m, double hopSeconds );
+void destroyMelodyFollower( struct melodyFollower * f );
+//Goes back to the start of the melody
+void resetMelodyFollower( struct melodyFollower * f );
+//Matches the next hop, sung at midi (a fractional MIDI note) or silent if sounding is false, and returns
+//the note of the melody it lines up with, or MELODY_REST
+int followMelody( struct melodyFollower * f, float midi, bool sounding );
+
+#endif
@@ -0,0 +1,119 @@
+/* metrics.c - fixed-memory latency histograms for each stage of the pipeline */
+
+#include "metrics.h"
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+const char * const STAGE_NAMES[NUM_STAGES] = {
+   "read", "filter", "onset", "window", "fft", "peak", "yin", "bank", "align", "score", "display", "latency"
+};
+
+void clearMetrics( struct metrics * m ){
+   memset( m, 0, sizeof( *m ) );
+}
+
+static void mergeHistogram( struct histogram * dst, const struct histogram * src ){
+   dst->count += src->count;
+   dst->sum += src->sum;
+   if( src->max > dst->max ) dst->max = src->max;
+   for( int i = 0; i < HISTOGRAM_BUCKETS; ++i )
+      dst->buckets[i] += src->buckets[i];
+}
+
+void mergeMetrics( struct metrics * dst, const struct metrics * src ){
+   for( int s = 0; s < NUM_STAGES; ++s )
+      mergeHistogram( &dst->stages[s], &src->stages[s] );
+   mergeHistogram( &dst->backlog, &src->backlog );
+}
+
+uint64_t monotonicNanos( void ){
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//The position of value's leading one; value is not 0
+static int leadingBit( uint64_t value ){
+#if defined( __GNUC__ )
+   return 63 - __builtin_clzll( value );
+#else
+   int bit = 0;
+   while( value >>= 1 )
+      ++bit;
+   return bit;
+#endif
+}
+
+//Values below 2 * HISTOGRAM_SUB_BUCKETS have a bucket each; above that, each doubling is split in
+//HISTOGRAM_SUB_BUCKETS by the bits after the leading one
+static int bucketOf( uint64_t value ){
+   if( value < 2 * HISTOGRAM_SUB_BUCKETS ) return (int) value;
+   int octave = leadingBit( value );
+   int sub = (int)( value >> ( octave - 3 ) ) & ( HISTOGRAM_SUB_BUCKETS - 1 );
+   int bucket = 2 * HISTOGRAM_SUB_BUCKETS + ( octave - 4 ) * HISTOGRAM_SUB_BUCKETS + sub;
+   return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+//The middle of the values that go in bucket
+static uint64_t bucketValue( int bucket ){
+   if( bucket < 2 * HISTOGRAM_SUB_BUCKETS ) return bucket;
+   int octave = ( bucket - 2 * HISTOGRAM_SUB_BUCKETS ) / HISTOGRAM_SUB_BUCKETS + 4;
+   int sub = ( bucket - 2 * HISTOGRAM_SUB_BUCKETS ) % HISTOGRAM_SUB_BUCKETS;
+   uint64_t width = (uint64_t) 1 << ( octave - 3 );
+   return ( HISTOGRAM_SUB_BUCKETS + sub ) * width + width / 2;
+}
+
+void recordValue( struct histogram * h, uint64_t value ){
+   h->count++;
+   h->sum += value;
+   if( value > h->max ) h->max = value;
+   h->buckets[bucketOf( value )]++;
+}
+
+uint64_t recordStage( struct metrics * m, int stage, uint64_t start ){
+   uint64_t now = monotonicNanos();
+   recordValue( &m->stages[stage], now - start );
+   return now;
+}
+
+uint64_t histogramPercentile( const struct histogram * h, double fraction ){
+   uint64_t target = (uint64_t) ceil( fraction * h->count ), seen = 0;
+   for( int i = 0; i < HISTOGRAM_BUCKETS; ++i ) {
+      seen += h->buckets[i];
+      if( seen >= target && seen > 0 ) {
+         uint64_t v = bucketValue( i );
+         return v < h->max ? v : h->max;
+      }
+   }
+   return h->max;
+}
+
+//Writes the opening brace and counts of h; the caller may add members before closing it
+static void writeHistogramJson( FILE * f, const struct histogram * h, const char * unit ){
+   fprintf( f, "{ \"count\": %llu, \"mean_%s\": %.0f, \"p50_%s\": %llu, \"p90_%s\": %llu, "
+      "\"p99_%s\": %llu, \"max_%s\": %llu", (unsigned long long) h->count,
+      unit, h->count ? (double) h->sum / h->count : 0.0,
+      unit, (unsigned long long) histogramPercentile( h, .5 ),
+      unit, (unsigned long long) histogramPercentile( h, .9 ),
+      unit, (unsigned long long) histogramPercentile( h, .99 ),
+      unit, (unsigned long long) h->max );
+}
+
+void writeMetricsJson( FILE * f, const struct metrics * m, double seconds ){
+   fprintf( f, "  \"stages\": {\n" );
+   for( int s = 0; s < NUM_STAGES; ++s ) {
+      const struct histogram * h = &m->stages[s];
+      fprintf( f, "    \"%s\": ", STAGE_NAMES[s] );
+      writeHistogramJson( f, h, "ns" );
+      //latency overlaps the other stages, so it takes no share of the time
+      if( s != STAGE_LATENCY )
+         fprintf( f, ", \"total_ns\": %llu, \"share\": %.6f", (unsigned long long) h->sum,
+            seconds > 0 ? h->sum * 1e-9 / seconds : 0.0 );
+      fprintf( f, " }%s\n", s + 1 < NUM_STAGES ? "," : "" );
+   }
+   fprintf( f, "  },\n" );
+   fprintf( f, "  \"backlog\": " );
+   writeHistogramJson( f, &m->backlog, "samples" );
+   fprintf( f, " }\n" );
+}
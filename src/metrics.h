@@ -0,0 +1,60 @@
+/* metrics.h - fixed-memory latency histograms for each stage of the pipeline
+ *
+ * Every stage of every hop is timed with the monotonic clock and counted
+ * in a histogram with eight buckets per doubling, so percentiles come out
+ * within about 6% with no allocation and no locks: each analysis keeps
+ * its own, and they are merged once the session is over.  Timing a stage
+ * costs one clock read, a few tens of nanoseconds against the tens of
+ * microseconds a hop takes, so it is always on.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BUCKETS (8) //per doubling
+#define HISTOGRAM_BUCKETS (2 * HISTOGRAM_SUB_BUCKETS + 40 * HISTOGRAM_SUB_BUCKETS) //exact below 16, up to 2^44
+
+/* -- what is timed -- */
+enum {
+   STAGE_READ, //waiting for and reading a hop of input
+   STAGE_FILTER,
+   STAGE_ONSET, //the noise gate and spectral flux
+   STAGE_WINDOW,
+   STAGE_FFT,
+   STAGE_PEAK, //finding and interpolating the peak
+   STAGE_YIN, //the whole yin detector
+   STAGE_BANK, //the whole note bank detector
+   STAGE_ALIGN, //following the melody
+   STAGE_SCORE, //the note, cents and updateInfo()
+   STAGE_DISPLAY,
+   STAGE_LATENCY, //from a hop being read to its pitch being on the screen
+   NUM_STAGES
+};
+
+extern const char * const STAGE_NAMES[NUM_STAGES];
+
+struct histogram {
+   uint64_t count, sum, max;
+   uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+struct metrics {
+   struct histogram stages[NUM_STAGES]; //in nanoseconds
+   struct histogram backlog; //input samples waiting to be read after each hop
+};
+
+void clearMetrics( struct metrics * m );
+void mergeMetrics( struct metrics * dst, const struct metrics * src );
+uint64_t monotonicNanos( void );
+void recordValue( struct histogram * h, uint64_t value );
+//Records the time since start against stage and returns the time now, which starts the next stage
+uint64_t recordStage( struct metrics * m, int stage, uint64_t start );
+//Returns a value that fraction of the values recorded were at or below, to within a bucket
+uint64_t histogramPercentile( const struct histogram * h, double fraction );
+//Writes the stages and backlog as the last members of a JSON object, with each stage's share of seconds
+void writeMetricsJson( FILE * f, const struct metrics * m, double seconds );
+
+#endif
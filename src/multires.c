@@ -0,0 +1,82 @@
+/* multires.c - FFT peak picking over the shortest window that resolves the pitch */
+
+#include "multires.h"
+#include <math.h>
+#include "libfft.h"
+#include "dsp.h"
+#include "tables.h"
+#include "stats.h"
+#include "metrics.h"
+
+int initMultiResolution( struct multiResolution * m, int size, float sampleRate ){
+   //half the accuracy threshold, as a frequency ratio
+   double ratio = pow( 2, ACCURACY_THRESHOLD / 2 / 1200 ) - 1;
+   m->sampleRate = sampleRate;
+   m->numLevels = 0;
+   m->lastLevel = 0;
+   for( int l = 0; l < MULTI_LEVELS && ( size >> ( 2 * l ) ) >= MULTI_MIN_SIZE; ++l ) {
+      int n = size >> ( 2 * l );
+      int bits = 0;
+      while( ( 1 << bits ) < n )
+         ++bits;
+      m->sizes[l] = n;
+      //a pitch f is off by about PEAK_ERROR_BINS * sampleRate / n Hz
+      m->minFrequency[l] = PEAK_ERROR_BINS * sampleRate / n / ratio;
+      m->ffts[l] = initfft( bits );
+      m->numLevels = l + 1;
+      if( !m->ffts[l] ) {
+         destroyMultiResolution( m );
+         return 1;
+      }
+      m->windows[l] = hanWindows[bits];
+   }
+   m->minFrequency[0] = 0; //the longest window is used for whatever the others can't resolve
+   return m->numLevels ? 0 : 1;
+}
+
+void destroyMultiResolution( struct multiResolution * m ){
+   for( int l = 0; l < m->numLevels; ++l ) {
+      if( m->ffts[l] ) destroyfft( m->ffts[l] );
+   }
+   m->numLevels = 0;
+}
+
+//Like recordStage(), but for no metrics at all
+static uint64_t timeStage( struct metrics * metrics, int stage, uint64_t start ){
+   return metrics ? recordStage( metrics, stage, start ) : 0;
+}
+
+//Transforms the newest samples for level l and returns the interpolated peak below maxBin in Hz
+static float levelPitch( struct multiResolution * m, int l, const float * ring, int start, int size, float * data,
+   float * datai, int maxBin, float * amplitude, struct metrics * metrics ){
+   int n = m->sizes[l];
+   uint64_t t = metrics ? monotonicNanos() : 0;
+   applyRecentWindow( m->windows[l], ring, size, start, data, n );
+   t = timeStage( metrics, STAGE_WINDOW, t );
+   applyrealfft( m->ffts[l], data, data, datai );
+   t = timeStage( metrics, STAGE_FFT, t );
+   int bins = maxBin < n / 2 ? maxBin : n / 2;
+   int peak = findPeak( data, datai, bins );
+   float bin = peak + interpolatePeak( data, datai, n / 2, peak );
+   //the transform is scaled by 1/n and the Han window halves a tone, so a full scale sine peaks at 1/4
+   *amplitude = 4 * sqrtf( data[peak] * data[peak] + datai[peak] * datai[peak] );
+   timeStage( metrics, STAGE_PEAK, t );
+   return bin * m->sampleRate / n;
+}
+
+float multiResolutionPitch( struct multiResolution * m, const float * ring, int start, int size, float * data,
+   float * datai, float * amplitude, struct metrics * metrics ){
+   int l = m->numLevels - 1;
+   float freq = levelPitch( m, l, ring, start, size, data, datai, m->sizes[l] / 2, amplitude, metrics );
+   while( l > 0 && freq < m->minFrequency[l] ) {
+      //too low for this window: go straight to the shortest one that resolves it, and only look as high
+      //as this one could have missed
+      float ceiling = MULTI_SEARCH_MARGIN * m->minFrequency[l];
+      while( l > 0 && freq < m->minFrequency[l] )
+         --l;
+      int maxBin = (int) ceilf( ceiling * m->sizes[l] / m->sampleRate ) + 1;
+      freq = levelPitch( m, l, ring, start, size, data, datai, maxBin, amplitude, metrics );
+   }
+   m->lastLevel = l;
+   return freq;
+}
@@ -0,0 +1,42 @@
+/* multires.h - FFT peak picking over the shortest window that resolves the pitch
+ *
+ * A high note is resolved to a few cents by a window a fraction as long
+ * as a low one needs, so waiting for a full second of input before every
+ * estimate only costs the high voices time.  Each hop first looks at the
+ * shortest window; only if the pitch it finds is too low for that window
+ * to pin down does it go to the shortest longer window that can, searching
+ * that window's spectrum only near the register the first one found.  A
+ * soprano is followed with a sixteenth of the delay, and a bass costs
+ * about what one full window did.
+ */
+
+#ifndef MULTIRES_H
+#define MULTIRES_H
+
+struct metrics;
+
+#define MULTI_LEVELS (3) //window lengths: the full window, a quarter and a sixteenth of it
+#define MULTI_MIN_SIZE (64) //shorter levels are left out
+#define PEAK_ERROR_BINS (.1) //how far interpolatePeak() may be off on a voice
+#define MULTI_SEARCH_MARGIN (2.0) //a longer window is searched up to this times the lowest pitch the shorter one resolves
+
+struct multiResolution {
+   float sampleRate;
+   int numLevels; //level 0 is the longest
+   int sizes[MULTI_LEVELS];
+   float minFrequency[MULTI_LEVELS]; //lowest pitch each level resolves to within half of ACCURACY_THRESHOLD
+   const float * windows[MULTI_LEVELS]; //from hanWindows
+   void * ffts[MULTI_LEVELS];
+   int lastLevel; //the level the last pitch came from
+};
+
+//Sets up levels for a window of size samples (a power of two) at sampleRate. Returns 0 on success.
+int initMultiResolution( struct multiResolution * m, int size, float sampleRate );
+void destroyMultiResolution( struct multiResolution * m );
+//Finds the pitch of the newest samples of a ring of size samples whose oldest is at start. data and
+//datai are scratch of the full window's size. Returns the pitch in Hz and sets amplitude to its peak's.
+//The window, fft and peak stages are timed into metrics unless it is NULL.
+float multiResolutionPitch( struct multiResolution * m, const float * ring, int start, int size, float * data,
+   float * datai, float * amplitude, struct metrics * metrics );
+
+#endif
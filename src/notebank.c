@@ -0,0 +1,139 @@
+/* notebank.c - a bank of sliding DFT bins, one group per note, in place of the FFT */
+
+#include "notebank.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+#include "dsp.h"
+
+int initNoteBank( struct noteBank * b, float sampleRate, int lowNote, int highNote, int ringSize, int hop ){
+   double semitone = pow( 2, 1.0 / NUMNOTES ) - 1;
+   b->sampleRate = sampleRate;
+   b->numNotes = 0;
+   b->maxSize = 0;
+   b->notes = malloc( ( highNote - lowNote + 1 ) * sizeof( struct noteBin ) );
+   if( !b->notes ) return 1;
+   for( int m = lowNote; m <= highNote; ++m ) {
+      double f = A4_FREQUENCY * pow( 2, (double)( m - A4_MIDI_NOTE ) / NUMNOTES );
+      int size = (int) lround( sampleRate / ( f * semitone ) );
+      //the sample leaving the window must still be in the ring when a hop comes in, and the top bin
+      //must stay below the Nyquist frequency
+      if( size > ringSize - hop || f * ( 1 + 2 * semitone ) >= sampleRate / 2 ) continue;
+      struct noteBin * n = &b->notes[b->numNotes++];
+      n->midiNote = m;
+      n->size = size;
+      n->frequency = f;
+      n->binWidth = sampleRate / size;
+      for( int k = 0; k < NOTE_BANK_BINS; ++k ) {
+         double w = 2 * M_PI * ( f + ( k - NOTE_BANK_BINS / 2 ) * n->binWidth ) / sampleRate;
+         n->rotate[k][0] = cos( w );
+         n->rotate[k][1] = sin( w );
+         n->leave[k][0] = cos( w * size );
+         n->leave[k][1] = sin( w * size );
+      }
+      if( size > b->maxSize ) b->maxSize = size;
+   }
+   if( b->numNotes == 0 ) {
+      destroyNoteBank( b );
+      return 1;
+   }
+   resetNoteBank( b );
+   return 0;
+}
+
+void destroyNoteBank( struct noteBank * b ){
+   free( b->notes );
+   b->notes = NULL;
+   b->numNotes = 0;
+}
+
+void resetNoteBank( struct noteBank * b ){
+   b->processed = 0;
+}
+
+//Works out n's bins from scratch over the window ending at ring[newest]: S = sum of x[newest - m] e^{j w m}
+static void recomputeBins( struct noteBin * n, const float * ring, int size, int newest ){
+   for( int k = 0; k < NOTE_BANK_BINS; ++k ) {
+      double sr = 0, si = 0, pr = 1, pi = 0;
+      int i = newest;
+      for( int m = 0; m < n->size; ++m ) {
+         sr += ring[i] * pr;
+         si += ring[i] * pi;
+         double t = pr * n->rotate[k][0] - pi * n->rotate[k][1];
+         pi = pr * n->rotate[k][1] + pi * n->rotate[k][0];
+         pr = t;
+         if( --i < 0 ) i = size - 1;
+      }
+      n->state[k][0] = sr;
+      n->state[k][1] = si;
+   }
+}
+
+//Slides n's window over count new samples, the first at ring[first]: S' = e^{j w} S + x[t] - x[t - size] e^{j w size}
+static void slideBins( struct noteBin * n, const float * ring, int size, int first, int count ){
+   double s[NOTE_BANK_BINS][2];
+   for( int k = 0; k < NOTE_BANK_BINS; ++k ) {
+      s[k][0] = n->state[k][0];
+      s[k][1] = n->state[k][1];
+   }
+   int in = first, out = ( first - n->size + size ) % size;
+   for( int i = 0; i < count; ++i ) {
+      double x = ring[in], old = ring[out];
+      for( int k = 0; k < NOTE_BANK_BINS; ++k ) {
+         double r = s[k][0] * n->rotate[k][0] - s[k][1] * n->rotate[k][1] + x - old * n->leave[k][0];
+         s[k][1] = s[k][0] * n->rotate[k][1] + s[k][1] * n->rotate[k][0] - old * n->leave[k][1];
+         s[k][0] = r;
+      }
+      if( ++in == size ) in = 0;
+      if( ++out == size ) out = 0;
+   }
+   for( int k = 0; k < NOTE_BANK_BINS; ++k ) {
+      n->state[k][0] = s[k][0];
+      n->state[k][1] = s[k][1];
+   }
+}
+
+//Writes the Hann windowed values a bin below, at and a bin above the note, from its five plain bins
+static void hannBins( const struct noteBin * n, float * re, float * im ){
+   for( int k = 0; k < 3; ++k ) {
+      re[k] = .5 * n->state[k + 1][0] - .25 * ( n->state[k][0] + n->state[k + 2][0] );
+      im[k] = .5 * n->state[k + 1][1] - .25 * ( n->state[k][1] + n->state[k + 2][1] );
+   }
+}
+
+float noteBankPitch( struct noteBank * b, const float * ring, int start, int size, long long total,
+   float * amplitude ){
+   long long count = total - b->processed;
+   int newest = ( start - 1 + size ) % size;
+   //after a gap longer than the ring can bridge, such as a hop the noise gate skipped, start over
+   bool afresh = b->processed == 0 || count > size - b->maxSize;
+   for( int i = 0; i < b->numNotes; ++i ) {
+      if( afresh )
+         recomputeBins( &b->notes[i], ring, size, newest );
+      else
+         slideBins( &b->notes[i], ring, size, (int)( ( start - count + size ) % size ), (int) count );
+   }
+   b->processed = total;
+
+   //the note whose own bin is loudest, for its window's length
+   int loudest = -1;
+   float most = 0;
+   for( int i = 0; i < b->numNotes; ++i ) {
+      float re[3], im[3];
+      hannBins( &b->notes[i], re, im );
+      float power = ( re[1] * re[1] + im[1] * im[1] ) / ( (float) b->notes[i].size * b->notes[i].size );
+      if( power > most ) {
+         most = power;
+         loudest = i;
+      }
+   }
+   *amplitude = 4 * sqrtf( most ); //a full scale sine gives a bin of size / 4
+   if( loudest < 0 ) return 0;
+   const struct noteBin * n = &b->notes[loudest];
+   float re[3], im[3];
+   hannBins( n, re, im );
+   //any pitch is within half a semitone, so half a bin, of its note
+   float delta = interpolatePeak( re, im, 3, 1 );
+   delta -= NOTE_BANK_BIAS * delta * ( .25f - delta * delta );
+   return n->frequency + delta * n->binWidth;
+}
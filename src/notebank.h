@@ -0,0 +1,55 @@
+/* notebank.h - a bank of sliding DFT bins, one group per note, in place of the FFT
+ *
+ * A peak search only cares about the notes a singer can sing, yet an FFT
+ * works out every bin of the spectrum each hop.  The bank keeps a few
+ * bins per note instead, each updated with every new sample by a sliding
+ * DFT: rotate, add the newest sample, take away the one leaving the
+ * window.  That is constant work per bin and sample, so a hop costs work
+ * in proportion to the notes in range times the hop, not N log N, and
+ * narrowing the range to one singer's two octaves or so cuts it further.
+ *
+ * Each note gets its own window, about 17 periods long, so its bins are
+ * a semitone wide however high or low it is: a constant-Q analysis.  Five
+ * bins a semitone apart around the note give the Hann windowed value at
+ * the note and at a bin either side of it, by the usual frequency domain
+ * form of the window, and the peak is interpolated between those three as
+ * for the FFT.  The bins are kept in double precision, so rounding in the
+ * recursion takes days to show.
+ */
+
+#ifndef NOTEBANK_H
+#define NOTEBANK_H
+
+#define DEFAULT_LOW_NOTE (36) //C2
+#define DEFAULT_HIGH_NOTE (84) //C6
+#define NOTE_BANK_BINS (5) //per note: the note, and one and two bins either side
+#define NOTE_BANK_BIAS (.33) //corrects the interpolation for the Hann peak not quite being a Gaussian
+
+struct noteBin {
+   int midiNote;
+   int size; //of its window, in samples
+   float frequency, binWidth; //in Hz
+   double rotate[NOTE_BANK_BINS][2]; //e^{j w} for each bin
+   double leave[NOTE_BANK_BINS][2]; //e^{j w size}, what the sample leaving the window was turned by
+   double state[NOTE_BANK_BINS][2];
+};
+
+struct noteBank {
+   float sampleRate;
+   int numNotes;
+   struct noteBin * notes;
+   int maxSize; //the longest window
+   long long processed; //ring samples the bins have taken in, or 0 to work them out afresh
+};
+
+//Sets up a bin group for every note from lowNote to highNote whose window fits in ringSize - hop samples.
+//Returns 0 on success, or 1 if there is not enough memory or no note fits.
+int initNoteBank( struct noteBank * b, float sampleRate, int lowNote, int highNote, int ringSize, int hop );
+void destroyNoteBank( struct noteBank * b );
+void resetNoteBank( struct noteBank * b );
+//Brings the bins up to date with a ring of size samples whose oldest is at start, total samples having
+//been written to it in all. Returns the pitch of the loudest note in Hz, or 0, and sets amplitude to it.
+float noteBankPitch( struct noteBank * b, const float * ring, int start, int size, long long total,
+   float * amplitude );
+
+#endif
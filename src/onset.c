@@ -0,0 +1,102 @@
+/* onset.c - a noise gate and spectral flux onsets, ahead of pitch detection */
+
+#include "onset.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "libfft.h"
+#include "dsp.h"
+#include "tables.h"
+
+int initOnsetDetector( struct onsetDetector * o, float sampleRate, int maxSize, float noiseFloor ){
+   int bits = 0;
+   while( ( 1 << bits ) < ONSET_WINDOW_SECONDS * sampleRate || ( 1 << bits ) < ONSET_MIN_SIZE )
+      ++bits;
+   while( bits > 1 && ( 1 << bits ) > maxSize )
+      --bits;
+   o->size = 1 << bits;
+   o->openLevel = .5f * powf( 10, noiseFloor / 10 );
+   o->closeLevel = .5f * powf( 10, ( noiseFloor - GATE_HYSTERESIS_DB ) / 10 );
+   o->minGap = (int)( ONSET_MIN_GAP_SECONDS * sampleRate );
+   o->fft = initfft( bits );
+   o->data = malloc( o->size * sizeof( float ) );
+   o->datai = malloc( ( o->size / 2 + 1 ) * sizeof( float ) );
+   o->magnitudes = malloc( o->size / 2 * sizeof( float ) );
+   if( !o->fft || !o->data || !o->datai || !o->magnitudes ) {
+      destroyOnsetDetector( o );
+      return 1;
+   }
+   o->window = hanWindows[bits];
+   resetOnsetDetector( o );
+   return 0;
+}
+
+void destroyOnsetDetector( struct onsetDetector * o ){
+   if( o->fft ) destroyfft( o->fft );
+   free( o->data ); free( o->datai ); free( o->magnitudes );
+   o->fft = NULL;
+   o->data = o->datai = o->magnitudes = NULL;
+}
+
+void resetOnsetDetector( struct onsetDetector * o ){
+   o->sounding = false;
+   o->sinceOnset = 0;
+   o->total = 0;
+   memset( o->magnitudes, 0, o->size / 2 * sizeof( float ) );
+}
+
+//Closes the gate on a hop quieter than the floor, or keeps it closed. Returns whether it is open.
+static bool gateOpen( struct onsetDetector * o, float meanSquare ){
+   if( meanSquare < ( o->sounding ? o->closeLevel : o->openLevel ) ) {
+      o->sounding = false;
+      return false;
+   }
+   return true;
+}
+
+//Takes the magnitude spectrum of the newest samples, already windowed into data, and returns how much of
+//it was not there last time, as a share of the louder of the two, so the noise left as a note dies away
+//is no onset
+static float spectralFlux( struct onsetDetector * o ){
+   int bins = o->size / 2;
+   applyrealfft( o->fft, o->data, o->data, o->datai );
+   float total = 0, rise = 0;
+   for( int k = 1; k < bins; ++k ) { //the DC bin says nothing about a note
+      float m = sqrtf( o->data[k] * o->data[k] + o->datai[k] * o->datai[k] );
+      if( m > o->magnitudes[k] ) rise += m - o->magnitudes[k];
+      total += m;
+      o->magnitudes[k] = m;
+   }
+   float louder = total > o->total ? total : o->total;
+   o->total = total;
+   return louder > 0 ? rise / louder : 0;
+}
+
+//Whether the hop in data, through an open gate, starts a note
+static int classifyHop( struct onsetDetector * o, int hopSize ){
+   float flux = spectralFlux( o );
+   o->sinceOnset += hopSize;
+   if( !o->sounding || ( flux > ONSET_FLUX && o->sinceOnset >= o->minGap ) ) {
+      o->sounding = true;
+      o->sinceOnset = 0;
+      return ONSET_START;
+   }
+   return ONSET_NONE;
+}
+
+int detectOnset( struct onsetDetector * o, float meanSquare, const float * ring, int start, int size, int hopSize ){
+   if( !gateOpen( o, meanSquare ) ) return ONSET_SILENT;
+   applyRecentWindow( o->window, ring, size, start, o->data, o->size );
+   return classifyHop( o, hopSize );
+}
+
+int detectOnsetFixed( struct onsetDetector * o, float meanSquare, const int16_t * ring, int start, int size,
+   int hopSize ){
+   if( !gateOpen( o, meanSquare ) ) return ONSET_SILENT;
+   int first = ( start + size - o->size ) % size; //the oldest sample wanted
+   for( int i = 0, j = first; i < o->size; ++i ) {
+      o->data[i] = ring[j] * ( 1.0f / 32768 ) * o->window[i];
+      if( ++j == size ) j = 0;
+   }
+   return classifyHop( o, hopSize );
+}
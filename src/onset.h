@@ -0,0 +1,55 @@
+/* onset.h - a noise gate and spectral flux onsets, ahead of pitch detection
+ *
+ * Silence and breaths are most of a practice session, and a pitch found
+ * in them is noise that only drags the score down.  Before a hop goes to
+ * the pitch detector, the mean square of its raw input is held against a
+ * noise floor, which costs one multiply-add a sample; a quiet hop is not
+ * analyzed at all.  While the gate is open, a small transform of the
+ * newest samples is compared with the last one: when much of the energy
+ * is new (high spectral flux), a note has just started, even if it is the
+ * same note sung again.  Onsets and silence are what split frames into
+ * the note events that intervals are scored from.
+ */
+
+#ifndef ONSET_H
+#define ONSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEFAULT_NOISE_FLOOR_DB (-50.0) //relative to a full scale sine
+#define GATE_HYSTERESIS_DB (3.0) //a sounding channel goes quiet this far below the floor
+#define ONSET_WINDOW_SECONDS (.032) //about the shortest window that shows a voice's harmonics
+#define ONSET_MIN_SIZE (64)
+#define ONSET_FLUX (.3) //share of the spectrum that must be new for an onset
+#define ONSET_MIN_GAP_SECONDS (.1) //one attack spread over several hops is still one onset
+
+/* -- what detectOnset() makes of a hop -- */
+enum { ONSET_SILENT, ONSET_NONE, ONSET_START };
+
+struct onsetDetector {
+   float openLevel, closeLevel; //mean squares the gate opens at and closes below
+   int size; //of the flux window, a power of two
+   int minGap; //in ring samples
+   void * fft;
+   const float * window; //from hanWindows
+   float * data, * datai;
+   float * magnitudes; //of the last spectrum, size/2 long
+   float total; //of magnitudes
+   bool sounding;
+   int sinceOnset; //ring samples since the last onset
+};
+
+//Sets up for a ring at sampleRate holding maxSize samples, with a gate at noiseFloor dB. Returns 0 on success.
+int initOnsetDetector( struct onsetDetector * o, float sampleRate, int maxSize, float noiseFloor );
+void destroyOnsetDetector( struct onsetDetector * o );
+//Closes the gate, for a new recording
+void resetOnsetDetector( struct onsetDetector * o );
+//Classifies the hop of hopSize ring samples just added to a ring of size samples whose oldest is at start.
+//meanSquare is that of the hop's raw input, .5 for a full scale sine.
+int detectOnset( struct onsetDetector * o, float meanSquare, const float * ring, int start, int size, int hopSize );
+//The same for a ring of 16 bit samples. The transform is small, so it stays in floating point.
+int detectOnsetFixed( struct onsetDetector * o, float meanSquare, const int16_t * ring, int start, int size,
+   int hopSize );
+
+#endif
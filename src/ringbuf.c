@@ -0,0 +1,79 @@
+/* ringbuf.c - wait-free single-producer sample ring with one or more readers */
+
+#include "ringbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+int initRingBuffer( struct ringBuffer * rb, unsigned long size, int numReaders ){
+   if( numReaders < 1 || numReaders > MAX_RING_READERS ) return 1;
+   rb->buffer = malloc( size * sizeof( float ) );
+   if( !rb->buffer ) return 1;
+   rb->size = size;
+   rb->numReaders = numReaders;
+   rb->writeIndex = 0;
+   for( int i = 0; i < numReaders; ++i )
+      rb->readers[i].index = 0;
+   return 0;
+}
+
+void destroyRingBuffer( struct ringBuffer * rb ){
+   free( rb->buffer );
+   rb->buffer = NULL;
+}
+
+//The producer publishes samples by storing writeIndex with release ordering after copying them, and
+//a reader frees space by storing its index with release ordering after it is done with the samples.
+//Each side loads the other's indices with acquire ordering, so it never sees an index ahead of the data.
+unsigned long ringBufferWriteAvailable( struct ringBuffer * rb ){
+   unsigned long used = 0;
+   for( int i = 0; i < rb->numReaders; ++i ) {
+      unsigned long u = rb->writeIndex - __atomic_load_n( &rb->readers[i].index, __ATOMIC_ACQUIRE );
+      if( u > used ) used = u;
+   }
+   return rb->size - used;
+}
+
+unsigned long ringBufferWrite( struct ringBuffer * rb, const float * data, unsigned long count ){
+   unsigned long space = ringBufferWriteAvailable( rb );
+   if( count > space ) count = space;
+   unsigned long start = rb->writeIndex % rb->size;
+   unsigned long first = rb->size - start;
+   if( first > count ) first = count;
+   memcpy( rb->buffer + start, data, first * sizeof( float ) );
+   memcpy( rb->buffer, data + first, ( count - first ) * sizeof( float ) );
+   __atomic_store_n( &rb->writeIndex, rb->writeIndex + count, __ATOMIC_RELEASE );
+   return count;
+}
+
+unsigned long ringBufferReadAvailable( struct ringBuffer * rb, int reader ){
+   return __atomic_load_n( &rb->writeIndex, __ATOMIC_ACQUIRE ) - rb->readers[reader].index;
+}
+
+bool ringBufferPeek( struct ringBuffer * rb, int reader, unsigned long count,
+   const float ** data1, unsigned long * size1, const float ** data2, unsigned long * size2 ){
+   if( ringBufferReadAvailable( rb, reader ) < count ) return false;
+   unsigned long start = rb->readers[reader].index % rb->size;
+   unsigned long first = rb->size - start;
+   if( first > count ) first = count;
+   *data1 = rb->buffer + start;
+   *size1 = first;
+   *data2 = rb->buffer;
+   *size2 = count - first;
+   return true;
+}
+
+void ringBufferConsume( struct ringBuffer * rb, int reader, unsigned long count ){
+   __atomic_store_n( &rb->readers[reader].index, rb->readers[reader].index + count, __ATOMIC_RELEASE );
+}
+
+unsigned long ringBufferRead( struct ringBuffer * rb, int reader, float * data, unsigned long count ){
+   const float * data1, * data2;
+   unsigned long size1, size2;
+   unsigned long available = ringBufferReadAvailable( rb, reader );
+   if( count > available ) count = available;
+   if( !ringBufferPeek( rb, reader, count, &data1, &size1, &data2, &size2 ) ) return 0;
+   memcpy( data, data1, size1 * sizeof( float ) );
+   memcpy( data + size1, data2, size2 * sizeof( float ) );
+   ringBufferConsume( rb, reader, count );
+   return count;
+}
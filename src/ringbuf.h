@@ -0,0 +1,53 @@
+/* ringbuf.h - wait-free single-producer sample ring with one or more readers
+ *
+ * One thread may write while each reader thread reads at the same time
+ * without locks.  Every reader sees every sample (the ring broadcasts),
+ * and space is only reused once the slowest reader has moved past it.
+ * Neither side ever waits: a write into a full ring stores what fits and
+ * reports how much that was.
+ */
+
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+#include <stdbool.h>
+
+#define CACHE_LINE_SIZE (64)
+#define MAX_RING_READERS (64)
+
+struct ringReader {
+   unsigned long index; //only changed by this reader
+   char pad[CACHE_LINE_SIZE - sizeof( unsigned long )];
+};
+
+struct ringBuffer {
+   float * buffer;
+   unsigned long size;
+   int numReaders;
+   //the indices run freely and are reduced modulo size on use; each has its own cache line
+   //so the producer and readers don't keep stealing it from each other
+   char pad0[CACHE_LINE_SIZE];
+   unsigned long writeIndex; //only changed by the producer
+   char pad1[CACHE_LINE_SIZE];
+   struct ringReader readers[MAX_RING_READERS];
+};
+
+//Allocates room for exactly size samples, read by numReaders readers. Interleaved frames stay
+//whole at the wrap point if size is a multiple of the frame size. Returns 0 on success.
+int initRingBuffer( struct ringBuffer * rb, unsigned long size, int numReaders );
+void destroyRingBuffer( struct ringBuffer * rb );
+//Producer side: room for this many samples
+unsigned long ringBufferWriteAvailable( struct ringBuffer * rb );
+//Producer side: copies up to count samples in and returns how many fit
+unsigned long ringBufferWrite( struct ringBuffer * rb, const float * data, unsigned long count );
+//Reader side: number of samples ready to read
+unsigned long ringBufferReadAvailable( struct ringBuffer * rb, int reader );
+//Reader side: copies up to count samples out and returns how many there were
+unsigned long ringBufferRead( struct ringBuffer * rb, int reader, float * data, unsigned long count );
+//Reader side: points at the next count samples in place, as up to two spans because the data
+//may wrap. The samples stay valid until ringBufferConsume. Returns false if fewer are ready.
+bool ringBufferPeek( struct ringBuffer * rb, int reader, unsigned long count,
+   const float ** data1, unsigned long * size1, const float ** data2, unsigned long * size2 );
+void ringBufferConsume( struct ringBuffer * rb, int reader, unsigned long count );
+
+#endif
@@ -0,0 +1,282 @@
+/* stats.c - running totals for scoring a singer
+ *
+ * Copyright (C) 2012 by Bjorn Roche
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose and without fee is hereby granted, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  This software is provided "as is" without express or
+ * implied warranty.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stats.h"
+
+#define MIN_INTERVAL_SLOTS (64)
+
+//Spreads the keys, which come in runs, over the table
+static int intervalSlot(int key, int slots){
+   return (int)( ( (unsigned) key * 2654435761u ) >> 8 ) & ( slots - 1 );
+}
+
+//Doubles the interval table (or makes the first one). Returns false if there is not enough memory.
+static bool growIntervals(struct scoreCard * card){
+   int slots = card->intervalSlots ? card->intervalSlots * 2 : MIN_INTERVAL_SLOTS;
+   struct intervalStats * intervals = malloc(slots * sizeof(struct intervalStats));
+   if( !intervals ) return false;
+   for( int i = 0; i < slots; ++i )
+      intervals[i].key = -1;
+   for( int i = 0; i < card->intervalSlots; ++i ) {
+      if( card->intervals[i].key < 0 ) continue;
+      int s = intervalSlot(card->intervals[i].key, slots);
+      while( intervals[s].key >= 0 )
+         s = ( s + 1 ) & ( slots - 1 );
+      intervals[s] = card->intervals[i];
+   }
+   free(card->intervals);
+   card->intervals = intervals;
+   card->intervalSlots = slots;
+   return true;
+}
+
+//Returns the counts for key, adding them if the interval has not been sung before. Returns NULL if the
+//table is full and cannot grow, in which case the interval goes uncounted.
+static struct intervalStats * findInterval(struct scoreCard * card, int key){
+   if( ( card->numIntervals + 1 ) * 4 > card->intervalSlots * 3 && !growIntervals(card) )
+      return NULL;
+   int s = intervalSlot(key, card->intervalSlots);
+   while( card->intervals[s].key >= 0 && card->intervals[s].key != key )
+      s = ( s + 1 ) & ( card->intervalSlots - 1 );
+   if( card->intervals[s].key < 0 ) {
+      card->intervals[s].key = key;
+      card->intervals[s].played = 0;
+      card->intervals[s].missed = 0;
+      card->numIntervals++;
+   }
+   return &card->intervals[s];
+}
+
+//Prints the names of the notes that the user missed more than a specified percentage of the time. Returns true
+//if there are no frequently missed notes.
+bool printNotes(struct scoreCard * card){
+   bool perfect = true; //no missed notes
+   printf("Problem notes:\n");
+   for(int i = 0; i < NUM_SCORED_NOTES; i++){
+      if(card->notes[i].played){
+         float missed = (float) card->notes[i].missed / card->notes[i].played;
+         if(missed > MISS_THRESHOLD){
+            //print integer instead of float; integer is precise enough for this purpose
+            printf("%s%d (missed %d %% of the time)\n", NOTES[i % NUMNOTES],
+               (i / NUMNOTES) + 1, (int)(missed * SCORETOTAL));
+            perfect = false;
+         }
+      }
+   }
+   return perfect;
+}
+
+static int compareIntervals(const void * a, const void * b){
+   return ((const struct intervalStats *) a)->key - ((const struct intervalStats *) b)->key;
+}
+
+//Prints the interval jumps that the user missed more than a specified percentage of the time. Returns true
+//if there are no frequently missed intervals, and false if there are or they could not be listed.
+bool printIntervals(struct scoreCard * card){
+   printf("Problem intervals:\n");
+   //only the intervals sung are visited; they are sorted so the report lists them from the lowest note up
+   struct intervalStats * problems = malloc((card->numIntervals ? card->numIntervals : 1) * sizeof(struct intervalStats));
+   int numProblems = 0;
+   if( !problems ) {
+      fprintf( stderr, "Could not allocate for the interval report.\n" );
+      printf("(could not be listed)\n");
+      return false;
+   }
+   for(int s = 0; s < card->intervalSlots; s++){
+      const struct intervalStats * interval = &card->intervals[s];
+      if(interval->key >= 0 && (float) interval->missed / interval->played > MISS_THRESHOLD)
+         problems[numProblems++] = *interval;
+   }
+   qsort(problems, numProblems, sizeof(struct intervalStats), compareIntervals);
+   for(int k = 0; k < numProblems; k++){
+      int i = problems[k].key / NUM_SCORED_NOTES, j = problems[k].key % NUM_SCORED_NOTES;
+      float missed = (float) problems[k].missed / problems[k].played;
+      //print integer instead of float; integer is precise enough for this purpose
+      printf("%s%d -> %s%d (missed %d %% of the time)\n", NOTES[i % NUMNOTES],
+         (i / NUMNOTES) + 1, NOTES[j % NUMNOTES], (j / NUMNOTES) + 1, (int)(missed * SCORETOTAL));
+   }
+   free(problems);
+   return numProblems == 0;
+}
+
+//Prints, for every note sung often enough, a bar of how often it was how many cents off, from 50 flat on
+//the left to 50 sharp on the right, and the 5 cent range it was usually in.
+void printDistribution(struct scoreCard * card){
+   static const char shades[] = " .:-=+*#%@";
+   printf("Cents by note (50 flat to 50 sharp):\n");
+   for(int i = 0; i < NUM_SCORED_NOTES; i++){
+      const struct noteStats * note = &card->notes[i];
+      if(note->played == 0 || note->played < DISTRIBUTION_SHARE * card->numInputs) continue;
+      int most = 0, median = 0, seen = 0;
+      for(int b = 0; b < NUM_CENTS_BUCKETS; b++)
+         if(note->cents[b] > most) most = note->cents[b];
+      for(median = 0; median < NUM_CENTS_BUCKETS - 1; median++){
+         seen += note->cents[median];
+         if(2 * seen >= note->played) break;
+      }
+      char name[8];
+      snprintf(name, sizeof(name), "%s%d", NOTES[i % NUMNOTES], (i / NUMNOTES) + 1);
+      printf("%-4s[", name);
+      for(int b = 0; b < NUM_CENTS_BUCKETS; b++){
+         int shade = note->cents[b] ? 1 + ( note->cents[b] * ( (int) sizeof(shades) - 3 ) ) / most : 0;
+         putchar(shades[shade]);
+      }
+      int low = median * CENTS_BUCKET_WIDTH - 50;
+      printf("] usually %+d to %+d cents, %d inputs\n", low, low + CENTS_BUCKET_WIDTH, note->played);
+   }
+}
+
+//Prints the pitch results of the recording:
+void printResults(struct scoreCard * card){
+   int numInputs = card->numInputs;
+   int numAccurate = card->numAccurate;
+   float score = card->score;
+   if(numInputs == 0){ //ensures no division by 0 is attempted
+      printf("No inputs recorded. \n");
+   } else {
+      float percentAccurate = (((float) numAccurate)/numInputs) * SCORETOTAL;
+      printf("Percent accurate: %d %% \n", (int)percentAccurate); //print integer instead of float; integer is precise enough for this purpose
+      printf("\n");
+      printf("Precision Score: %d / 100 \n", (int)(score/numInputs)); //print integer instead of float; integer is precise enough for this purpose
+      printf("\n");
+      printf("Notes sung: %d \n", card->numNotes);
+   }
+   printf("\n");
+   if(printNotes(card)) printf("None! Nice job! :D \n"); //if this is true, it means the user didn't frequently miss any notes
+   printf("\n");
+   if(printIntervals(card)) printf("None! Nice job! :D \n"); //if this is true, it means the user didn't frequently miss any intervals
+   if(numInputs > 0){
+      printf("\n");
+      printDistribution(card);
+   }
+}
+
+//Initializes the totals and the number of each note/interval played/missed to 0
+void initScoreCard(struct scoreCard * card){
+   memset(card, 0, sizeof(*card));
+   card->intervals = NULL;
+}
+
+void clearScoreCard(struct scoreCard * card){
+   struct intervalStats * intervals = card->intervals;
+   int slots = card->intervalSlots;
+   memset(card, 0, sizeof(*card));
+   card->intervals = intervals;
+   card->intervalSlots = slots;
+   for(int s = 0; s < slots; s++)
+      intervals[s].key = -1;
+}
+
+void destroyScoreCard(struct scoreCard * card){
+   free(card->intervals);
+   card->intervals = NULL;
+   card->intervalSlots = 0;
+   card->numIntervals = 0;
+}
+
+//Adds everything counted in src to dst, e.g. to combine the pieces of a recording scored separately.
+//Takes time in proportion to the notes and the intervals src has, not every possible interval.
+void mergeScoreCards(struct scoreCard * dst, const struct scoreCard * src){
+   dst->numInputs += src->numInputs;
+   dst->numAccurate += src->numAccurate;
+   dst->score += src->score;
+   dst->numNotes += src->numNotes;
+   for(int i = 0; i < NUM_SCORED_NOTES; i++){
+      dst->notes[i].played += src->notes[i].played;
+      dst->notes[i].missed += src->notes[i].missed;
+      for(int b = 0; b < NUM_CENTS_BUCKETS; b++)
+         dst->notes[i].cents[b] += src->notes[i].cents[b];
+   }
+   for(int s = 0; s < src->intervalSlots; s++){
+      const struct intervalStats * from = &src->intervals[s];
+      if(from->key < 0) continue;
+      struct intervalStats * to = findInterval(dst, from->key);
+      if(!to) continue;
+      to->played += from->played;
+      to->missed += from->missed;
+   }
+}
+
+//updates accuracy/score/other pitch information based on the nearest MIDI note and how far off it was
+void updateInfo(struct scoreCard * card, int midiNote, float centsSharp){
+   int noteIndex = midiNote - LOWEST_MIDI_NOTE; //C1 is 0
+   if(noteIndex < 0 || noteIndex >= NUM_SCORED_NOTES) return; //return if outside of the span of the 8 octaves
+   struct noteStats * note = &card->notes[noteIndex];
+   note->played++;
+   int bucket = (int) floorf((centsSharp + 50) / CENTS_BUCKET_WIDTH);
+   note->cents[bucket < 0 ? 0 : bucket >= NUM_CENTS_BUCKETS ? NUM_CENTS_BUCKETS - 1 : bucket]++;
+   if(fabsf(centsSharp) < ACCURACY_THRESHOLD){
+      card->numAccurate++; //Count it as an accurate pitch if it's "close enough" in the range of the accuracy threshold
+   } else {
+      note->missed++;
+   }
+   float singleInputScore = SCORETOTAL - fabsf(centsSharp);
+   card->score += singleInputScore;
+}
+
+void initNoteTracker(struct noteTracker * tracker){
+   tracker->current.frames = 0;
+   tracker->prevNoteIndex = -1;
+}
+
+float noteEventCents(const struct noteEvent * note){
+   int seen = 0, b = 0;
+   for(; b < NOTE_CENTS_BUCKETS - 1; b++){
+      seen += note->cents[b];
+      if(2 * seen >= note->frames) break;
+   }
+   return b + .5f - NOTE_CENTS_BUCKETS / 2;
+}
+
+//Scores the interval from the last note event to this one, missed if this one was mostly out of tune.
+//Intervals come from whole notes rather than frames, so a note that starts off but settles counts once,
+//by where it settled.
+void finishNote(struct scoreCard * card, struct noteTracker * tracker){
+   struct noteEvent * note = &tracker->current;
+   int noteIndex = note->midiNote - LOWEST_MIDI_NOTE;
+   bool scored = note->frames > 0 && note->end - note->start >= MIN_NOTE_MICROSECONDS
+      && noteIndex >= 0 && noteIndex < NUM_SCORED_NOTES;
+   float cents = scored ? noteEventCents(note) : 0;
+   note->frames = 0;
+   if(!scored) return;
+   card->numNotes++;
+   int prevNoteIndex = tracker->prevNoteIndex;
+   if(prevNoteIndex >= 0 && prevNoteIndex != noteIndex){ //if it's not the first note or the same note
+      struct intervalStats * interval = findInterval(card, prevNoteIndex * NUM_SCORED_NOTES + noteIndex);
+      if(interval){
+         interval->played++;
+         if(fabsf(cents) >= ACCURACY_THRESHOLD) interval->missed++;
+      }
+   }
+   tracker->prevNoteIndex = noteIndex;
+}
+
+void trackNote(struct scoreCard * card, struct noteTracker * tracker, int64_t time, int midiNote, float centsSharp,
+   bool onset){
+   struct noteEvent * note = &tracker->current;
+   if(note->frames && (onset || midiNote != note->midiNote))
+      finishNote(card, tracker);
+   if(!note->frames){
+      memset(note, 0, sizeof(*note));
+      note->start = time;
+      note->midiNote = midiNote;
+   }
+   int bucket = (int) floorf(centsSharp + NOTE_CENTS_BUCKETS / 2);
+   note->cents[bucket < 0 ? 0 : bucket >= NOTE_CENTS_BUCKETS ? NOTE_CENTS_BUCKETS - 1 : bucket]++;
+   note->frames++;
+   note->end = time;
+}
@@ -0,0 +1,96 @@
+/* stats.h - running totals for scoring a singer
+ *
+ * Copyright (C) 2012 by Bjorn Roche
+ *
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation for any purpose and without fee is hereby granted, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation.  This software is provided "as is" without express or
+ * implied warranty.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dsp.h"
+
+#define SCORETOTAL (100)
+#define ACCURACY_THRESHOLD (10.0)
+#define MISS_THRESHOLD (.5)
+#define NUMOCTAVES (8)
+#define NUM_SCORED_NOTES (NUMNOTES * NUMOCTAVES)
+#define LOWEST_MIDI_NOTE (24) //C1, the first note the score card keeps
+#define CENTS_BUCKET_WIDTH (5)
+#define NUM_CENTS_BUCKETS (100 / CENTS_BUCKET_WIDTH) //from 50 cents flat to 50 cents sharp
+#define DISTRIBUTION_SHARE (.05) //notes sung less often than this are left out of the cents distribution
+#define MIN_NOTE_MICROSECONDS (100000) //a shorter note event is taken for a glitch and not scored
+#define NOTE_CENTS_BUCKETS (100) //one a cent, from 50 flat
+
+/* -- how often one note was sung and missed, and how far off it was -- */
+struct noteStats {
+   int played;
+   int missed;
+   int cents[NUM_CENTS_BUCKETS]; //bucket 0 holds -50 up to -45 cents
+};
+
+/* -- one slot of the interval table -- */
+struct intervalStats {
+   int key; //from * NUM_SCORED_NOTES + to, or -1 if the slot is empty
+   int played;
+   int missed;
+};
+
+/* -- one note sung: a run of frames on the same note with no onset or silence between them -- */
+struct noteEvent {
+   int64_t start, end; //microseconds of its first and last frames
+   int midiNote;
+   int frames; //0 if there is no note
+   int cents[NOTE_CENTS_BUCKETS]; //its frames by how many cents off they were
+};
+
+/* -- the note being sung on a channel, and the last one scored -- */
+struct noteTracker {
+   struct noteEvent current;
+   int prevNoteIndex; //of the last note event scored, or -1
+};
+
+/* -- running totals, and how often each note and interval was sung and missed --
+ * Only intervals actually sung take space: they live in an open addressing hash table that grows as
+ * needed. A card is only ever updated by the thread that owns it; cards from several threads, channels
+ * or chunks are combined afterwards with mergeScoreCards(). */
+struct scoreCard {
+   int numInputs; //number of inputs recorded
+   int numAccurate;
+   float score;
+   int numNotes; //note events scored
+   struct noteStats notes[NUM_SCORED_NOTES];
+   int numIntervals; //slots in use
+   int intervalSlots; //0 or a power of two
+   struct intervalStats * intervals;
+};
+
+void initScoreCard(struct scoreCard * card);
+//Zeroes every count but keeps the interval table for reuse
+void clearScoreCard(struct scoreCard * card);
+void destroyScoreCard(struct scoreCard * card);
+void updateInfo(struct scoreCard * card, int midiNote, float centsSharp);
+void initNoteTracker(struct noteTracker * tracker);
+//Adds a frame at time to the note being sung, or, if it is on another note or onset says a note started
+//with it, scores that note and starts a new one
+void trackNote(struct scoreCard * card, struct noteTracker * tracker, int64_t time, int midiNote, float centsSharp,
+   bool onset);
+//Scores the note being sung, if any, as the recording has ended
+void finishNote(struct scoreCard * card, struct noteTracker * tracker);
+//Returns the median cents of a note event's frames
+float noteEventCents(const struct noteEvent * note);
+void mergeScoreCards(struct scoreCard * dst, const struct scoreCard * src);
+void printResults(struct scoreCard * card);
+bool printIntervals(struct scoreCard * card);
+bool printNotes(struct scoreCard * card);
+void printDistribution(struct scoreCard * card);
+
+#endif
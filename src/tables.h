@@ -0,0 +1,35 @@
+/* tables.h - windows, twiddles and bit reversals worked out when the program is built
+ *
+ * Every FFT size from 2 to 65536 points needs a Hann window, cos and sin
+ * of its twiddle angles and a bit-reversal permutation.  Rather than each
+ * process computing them as it starts, tools/gentables.c prints them once
+ * at build time into objs/tables.c, and they are linked in as constants.
+ * They cost nothing to set up, and every running copy of the program
+ * shares the same read-only pages of them.
+ *
+ * Each size has tables of its own, in order, rather than one set for the
+ * largest size read with a stride, which touched a new cache line for
+ * nearly every twiddle.  The stage of a transform that combines 2^b point
+ * spectra reads the 2^b point twiddles, so every stage of every size reads
+ * its twiddles one after another.  Each array below holds one table per
+ * size, indexed by log2 of the size from 1 to LOG2_MAX_TABLE_SIZE.
+ */
+
+#ifndef TABLES_H
+#define TABLES_H
+
+#include <stdint.h>
+
+#define LOG2_MAX_TABLE_SIZE (16)
+#define MAX_TABLE_SIZE (1 << LOG2_MAX_TABLE_SIZE)
+
+//[b][k] is k with its b bits reversed; unlike the others, it has a table for 1 point, at [0]
+extern const uint16_t * const fftBitReverses[LOG2_MAX_TABLE_SIZE + 1];
+//[b][k] is cos or sin of 2 pi k / 2^b, for k below 2^(b-1); the fixed ones in Q31
+extern const float * const fftCosines[LOG2_MAX_TABLE_SIZE + 1], * const fftSines[LOG2_MAX_TABLE_SIZE + 1];
+extern const int32_t * const fixedFftCosines[LOG2_MAX_TABLE_SIZE + 1], * const fixedFftSines[LOG2_MAX_TABLE_SIZE + 1];
+//hanWindows[b] is the Hann window of 2^b samples; fixedHanWindows[b] in Q15
+extern const float * const hanWindows[LOG2_MAX_TABLE_SIZE + 1];
+extern const int16_t * const fixedHanWindows[LOG2_MAX_TABLE_SIZE + 1];
+
+#endif
@@ -0,0 +1,61 @@
+/* workqueue.c - per-thread task deques with work stealing */
+
+#include "workqueue.h"
+#include <stdlib.h>
+
+int initWorkQueue( struct workQueue * q, int numWorkers, int capacity ){
+   q->numWorkers = numWorkers;
+   q->deques = calloc( numWorkers, sizeof( struct taskDeque ) );
+   if( !q->deques ) return 1;
+   for( int w = 0; w < numWorkers; ++w ) {
+      struct taskDeque * d = &q->deques[w];
+      d->tasks = malloc( ( capacity ? capacity : 1 ) * sizeof( int ) ); //malloc( 0 ) may be NULL
+      if( !d->tasks ) {
+         q->numWorkers = w;
+         destroyWorkQueue( q );
+         return 1;
+      }
+      pthread_mutex_init( &d->lock, NULL );
+      d->head = d->tail = 0;
+   }
+   return 0;
+}
+
+void destroyWorkQueue( struct workQueue * q ){
+   for( int w = 0; w < q->numWorkers; ++w ) {
+      pthread_mutex_destroy( &q->deques[w].lock );
+      free( q->deques[w].tasks );
+   }
+   free( q->deques );
+   q->deques = NULL;
+   q->numWorkers = 0;
+}
+
+void pushTask( struct workQueue * q, int worker, int task ){
+   struct taskDeque * d = &q->deques[worker];
+   pthread_mutex_lock( &d->lock );
+   d->tasks[d->tail++] = task;
+   pthread_mutex_unlock( &d->lock );
+}
+
+bool nextTask( struct workQueue * q, int worker, int * task ){
+   struct taskDeque * d = &q->deques[worker];
+   bool found = false;
+   pthread_mutex_lock( &d->lock );
+   if( d->head < d->tail ) {
+      *task = d->tasks[d->head++];
+      found = true;
+   }
+   pthread_mutex_unlock( &d->lock );
+   //try the other workers in turn, starting with the next one so thieves spread out
+   for( int i = 1; !found && i < q->numWorkers; ++i ) {
+      struct taskDeque * victim = &q->deques[( worker + i ) % q->numWorkers];
+      pthread_mutex_lock( &victim->lock );
+      if( victim->head < victim->tail ) {
+         *task = victim->tasks[--victim->tail];
+         found = true;
+      }
+      pthread_mutex_unlock( &victim->lock );
+   }
+   return found;
+}
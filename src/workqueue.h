@@ -0,0 +1,35 @@
+/* workqueue.h - per-thread task deques with work stealing
+ *
+ * Every worker owns a deque of task numbers.  It takes its own tasks from
+ * the front; once its deque is empty it steals from the back of another
+ * worker's.  Each deque has its own lock, so workers only contend when one
+ * of them is stealing.
+ */
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+struct taskDeque {
+   pthread_mutex_t lock;
+   int * tasks;
+   int head; //next task the owner takes
+   int tail; //one past the task a thief takes
+};
+
+struct workQueue {
+   int numWorkers;
+   struct taskDeque * deques;
+};
+
+//Sets up numWorkers deques, each able to hold capacity tasks. Returns 0 on success.
+int initWorkQueue( struct workQueue * q, int numWorkers, int capacity );
+void destroyWorkQueue( struct workQueue * q );
+//Adds task to the back of worker's deque
+void pushTask( struct workQueue * q, int worker, int task );
+//Gets worker's next task, stealing one if its own deque is empty. Returns false once every deque is empty.
+bool nextTask( struct workQueue * q, int worker, int * task );
+
+#endif
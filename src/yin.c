@@ -0,0 +1,112 @@
+/* yin.c - YIN pitch detection with the difference function done by FFT */
+
+#include "yin.h"
+#include <stdlib.h>
+#include <math.h>
+#include "libfft.h"
+
+int initYin( struct yin * y, float sampleRate ){
+   y->sampleRate = sampleRate;
+   y->minPeriod = (int)( sampleRate / YIN_MAX_FREQUENCY );
+   if( y->minPeriod < 2 ) y->minPeriod = 2;
+   y->maxPeriod = (int) ceil( sampleRate / YIN_MIN_FREQUENCY );
+   y->window = 2 * y->maxPeriod;
+   y->frameSize = y->window + y->maxPeriod;
+   int bits = 1;
+   while( ( 1 << bits ) < y->frameSize )
+      ++bits;
+   y->fftSize = 1 << bits;
+   y->fft = initfft( bits );
+   y->zr = malloc( y->fftSize * sizeof( float ) );
+   y->zi = malloc( y->fftSize * sizeof( float ) );
+   y->cr = malloc( y->fftSize * sizeof( float ) );
+   y->ci = malloc( y->fftSize * sizeof( float ) );
+   y->energy = malloc( ( y->frameSize + 1 ) * sizeof( double ) );
+   y->diff = malloc( ( y->maxPeriod + 1 ) * sizeof( float ) );
+   if( !y->fft || !y->zr || !y->zi || !y->cr || !y->ci || !y->energy || !y->diff ) {
+      destroyYin( y );
+      return 1;
+   }
+   return 0;
+}
+
+void destroyYin( struct yin * y ){
+   if( y->fft ) destroyfft( y->fft );
+   free( y->zr ); free( y->zi ); free( y->cr ); free( y->ci );
+   free( y->energy ); free( y->diff );
+   y->fft = NULL;
+   y->zr = y->zi = y->cr = y->ci = y->diff = NULL;
+   y->energy = NULL;
+}
+
+//Fills cr with the correlation of the first window samples of the frame in zr with the whole frame,
+//at shifts 0..maxPeriod. zi holds the window. Both are real, so they share one complex transform:
+//with z = frame + i window, the two spectra are the even and odd parts of Z.
+static void correlate( struct yin * y ){
+   int n = y->fftSize;
+   applyfft( y->fft, y->zr, y->zi, false );
+   for( int k = 0; k < n; ++k ) {
+      int m = ( n - k ) & ( n - 1 );
+      //frame spectrum F = ( Z[k] + conj(Z[m]) ) / 2, window spectrum W = ( Z[k] - conj(Z[m]) ) / 2i
+      float fr = .5f * ( y->zr[k] + y->zr[m] ), fi = .5f * ( y->zi[k] - y->zi[m] );
+      float wr = .5f * ( y->zi[k] + y->zi[m] ), wi = -.5f * ( y->zr[k] - y->zr[m] );
+      //conj(W) F
+      y->cr[k] = wr * fr + wi * fi;
+      y->ci[k] = wr * fi - wi * fr;
+   }
+   applyfft( y->fft, y->cr, y->ci, true );
+   for( int t = 0; t <= y->maxPeriod; ++t )
+      y->cr[t] *= n; //the forward transform scaled both spectra by 1/n
+}
+
+//d(t) = sum over the window of ( x[j] - x[j+t] )^2 = e(0) + e(t) - 2 r(t)
+static double difference( struct yin * y, double e0, int t ){
+   double d = e0 + ( y->energy[t + y->window] - y->energy[t] ) - 2 * y->cr[t];
+   return d < 0 ? 0 : d; //rounding
+}
+
+float yinPitch( struct yin * y, const float * ring, int start, int size ){
+   int first = ( start + size - y->frameSize ) % size;
+   double sum = 0;
+   y->energy[0] = 0;
+   for( int i = 0; i < y->fftSize; ++i ) {
+      float x = 0;
+      if( i < y->frameSize ) {
+         x = ring[( first + i ) % size];
+         sum += x * x;
+         y->energy[i+1] = sum;
+      }
+      y->zr[i] = x;
+      y->zi[i] = i < y->window ? x : 0;
+   }
+   correlate( y );
+
+   //the difference normalized by its running mean, so it starts at 1 and no shift is favoured for being short
+   double e0 = y->energy[y->window];
+   y->amplitude = sqrt( 2 * e0 / y->window );
+   double runningSum = 0;
+   y->diff[0] = 1;
+   for( int t = 1; t <= y->maxPeriod; ++t ) {
+      double d = difference( y, e0, t );
+      runningSum += d;
+      y->diff[t] = runningSum > 0 ? d * t / runningSum : 1;
+   }
+
+   //the first dip below the threshold, followed down to its bottom
+   int t = y->minPeriod;
+   while( t < y->maxPeriod && y->diff[t] >= YIN_THRESHOLD )
+      ++t;
+   if( t >= y->maxPeriod )
+      return 0;
+   while( t + 1 < y->maxPeriod && y->diff[t+1] < y->diff[t] )
+      ++t;
+
+   //refine it with a parabola through its neighbours in the raw difference, which the normalization
+   //would skew towards longer periods
+   float period = t;
+   float l = difference( y, e0, t - 1 ), c = difference( y, e0, t ), r = difference( y, e0, t + 1 );
+   float curve = l - 2 * c + r;
+   if( curve > 0 )
+      period += .5f * ( l - r ) / curve;
+   return y->sampleRate / period;
+}
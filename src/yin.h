@@ -0,0 +1,39 @@
+/* yin.h - YIN pitch detection with the difference function done by FFT
+ *
+ * YIN compares a short window with itself shifted by every candidate
+ * period and picks the first shift where the two match closely.  It only
+ * needs about two periods of the lowest pitch it looks for, so a frame is
+ * tens of milliseconds long instead of the second an FFT peak needs.  The
+ * autocorrelation inside the difference function comes from one forward
+ * and one inverse complex FFT, so a frame costs O(N log N).
+ */
+
+#ifndef YIN_H
+#define YIN_H
+
+#define YIN_MIN_FREQUENCY (60.0) //lowest pitch looked for; about B1
+#define YIN_MAX_FREQUENCY (1100.0) //highest pitch looked for; about C#6
+#define YIN_THRESHOLD (.15) //a shift whose normalized difference is below this counts as a period
+
+struct yin {
+   float sampleRate;
+   int window; //samples compared at each shift, two of the longest periods
+   int minPeriod, maxPeriod; //shifts tried, in samples
+   int frameSize; //window + maxPeriod, the newest samples each frame uses
+   int fftSize; //at least frameSize, so the correlation never wraps
+   void * fft;
+   float * zr, * zi; //frame and window packed as one complex signal, then its spectrum
+   float * cr, * ci; //cross spectrum, then the autocorrelation
+   double * energy; //running sum of squares over the frame
+   float * diff; //cumulative mean normalized difference, by shift
+   float amplitude; //of a sine as loud as the last window
+};
+
+//Sets up for samples at sampleRate. Returns 0 on success.
+int initYin( struct yin * y, float sampleRate );
+void destroyYin( struct yin * y );
+//Finds the pitch of the newest frameSize samples of a ring of size samples whose oldest is at start.
+//Returns it in Hz, or 0 if the frame has no clear period.
+float yinPitch( struct yin * y, const float * ring, int start, int size );
+
+#endif
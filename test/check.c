@@ -0,0 +1,292 @@
+/* check.c - checks that the ways of scoring a recording agree
+ *
+ * Each check builds its own input in a scratch file, scores it two
+ * ways that should give the same card, and fails if they don't.  Batch
+ * scoring (-b) cuts a recording into chunks and scores them on separate
+ * threads; the recording here holds notes across the chunk boundaries,
+ * and its cards must match a single pass over it as -f does, for every
+ * detector.  A frame log whose last session crashed partway through a
+ * record must still replay every whole record, including those appended
+ * by later sessions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "analysis.h"
+#include "audiofile.h"
+#include "batch.h"
+#include "framelog.h"
+
+#define SAMPLE_RATE (8000)
+#define RECORDING_SECONDS (130) //three chunks in batch mode
+#define NOTE_SECONDS (1.7) //so notes start at all sorts of places, and are sung over 60 and 120 s
+#define REST_SECONDS (.3)
+#define AMPLITUDE (.3)
+#define CHECK_THREADS (4)
+#define SESSION_FRAMES (500) //logged by each session in the frame log check
+#define PARTIAL_BYTES (7) //of a record, written by a session that crashed
+
+//Writes seconds of 16 bit mono WAV at rate to path: a tune of held notes, each a little out of tune,
+//with a rest after every third. Returns 0 on success.
+static int writeTune( const char * path, int rate, int seconds ){
+   static const int tune[] = { 57, 60, 62, 64, 62, 67, 65, 64, 60, 59, 57, 69 }; //MIDI notes
+   unsigned long frames = (unsigned long) rate * seconds, dataBytes = frames * 2;
+   unsigned char header[44] = "RIFF....WAVEfmt \x10\0\0\0\x01\0\x01\0........\x02\0\x10\0data....";
+   unsigned long fields[4][2] = { { 4, dataBytes + 36 }, { 24, rate }, { 28, rate * 2UL }, { 40, dataBytes } };
+   for( int f = 0; f < 4; ++f )
+      for( int b = 0; b < 4; ++b )
+         header[fields[f][0] + b] = fields[f][1] >> ( 8 * b ) & 0xff;
+   FILE * out = fopen( path, "wb" );
+   if( !out ) {
+      perror( path );
+      return 1;
+   }
+   fwrite( header, 1, sizeof( header ), out );
+   double phase = 0;
+   for( unsigned long i = 0; i < frames; ++i ) {
+      double t = (double) i / rate;
+      int n = (int) ( t / NOTE_SECONDS );
+      double into = t - n * NOTE_SECONDS;
+      double v = 0;
+      if( n % 3 != 2 || into < NOTE_SECONDS - REST_SECONDS ) {
+         double cents = ( n * 37 % 41 ) - 20; //up to 20 off either way
+         double freq = 440 * pow( 2, ( tune[n % 12] - 69 + cents / 100 ) / 12 );
+         phase += 2 * M_PI * freq / rate;
+         v = AMPLITUDE * sin( phase );
+      }
+      short s = (short) lround( v * 32767 );
+      unsigned char bytes[2] = { s & 0xff, ( s >> 8 ) & 0xff };
+      fwrite( bytes, 1, 2, out );
+   }
+   if( fclose( out ) ) {
+      perror( path );
+      return 1;
+   }
+   return 0;
+}
+
+//Scores a recording in one pass, as -f does. Returns 0 on success.
+static int scoreWhole( const char * path, const struct analysisOptions * options, struct scoreCard * card ){
+   struct audioFile af;
+   struct analysis an;
+   char * nearestNoteName;
+   float centsSharp;
+   if( openAudioFile( path, 0, &af ) ) return 1;
+   if( initAnalysis( &an, options ) ) {
+      closeAudioFile( &af );
+      return 1;
+   }
+   for( size_t frame = 0; frame + an.hop <= af.frames; frame += an.hop ) {
+      if( an.fixedPoint ) {
+         readAudioFile16( &af, frame, 0, an.input16, an.hop );
+         filterInputFixed( &an, an.input16, an.hop, 1 );
+      } else {
+         readAudioFile( &af, frame, 0, an.input, an.hop );
+         filterInput( &an, an.input, an.hop, 1 );
+      }
+      analyzeHop( &an, &nearestNoteName, &centsSharp );
+   }
+   finishAnalyses( &an, 1 );
+   *card = an.card;
+   initScoreCard( &an.card ); //the intervals are card's now
+   destroyAnalysis( &an );
+   closeAudioFile( &af );
+   return 0;
+}
+
+static const struct intervalStats * findInterval( const struct scoreCard * card, int key ){
+   for( int s = 0; s < card->intervalSlots; ++s )
+      if( card->intervals[s].key == key )
+         return &card->intervals[s];
+   return NULL;
+}
+
+//Returns 0 if two cards counted the same things, or prints how they differ and returns 1
+static int compareCards( const char * what, const struct scoreCard * a, const struct scoreCard * b ){
+   int failed = 0;
+   if( a->numInputs != b->numInputs || a->numAccurate != b->numAccurate || a->numNotes != b->numNotes ) {
+      fprintf( stderr, "%s: %d inputs, %d accurate, %d notes against %d, %d and %d\n", what,
+         a->numInputs, a->numAccurate, a->numNotes, b->numInputs, b->numAccurate, b->numNotes );
+      failed = 1;
+   }
+   if( a->score != b->score ) {
+      fprintf( stderr, "%s: scores %g and %g\n", what, a->score, b->score );
+      failed = 1;
+   }
+   if( memcmp( a->notes, b->notes, sizeof( a->notes ) ) ) {
+      fprintf( stderr, "%s: notes counted differently\n", what );
+      failed = 1;
+   }
+   if( a->numIntervals != b->numIntervals ) {
+      fprintf( stderr, "%s: %d intervals against %d\n", what, a->numIntervals, b->numIntervals );
+      failed = 1;
+   }
+   for( int s = 0; s < a->intervalSlots; ++s ) {
+      const struct intervalStats * x = &a->intervals[s], * y;
+      if( x->key < 0 ) continue;
+      y = findInterval( b, x->key );
+      if( !y || x->played != y->played || x->missed != y->missed ) {
+         fprintf( stderr, "%s: interval %d -> %d counted differently\n", what,
+            x->key / NUM_SCORED_NOTES + LOWEST_MIDI_NOTE, x->key % NUM_SCORED_NOTES + LOWEST_MIDI_NOTE );
+         failed = 1;
+      }
+   }
+   return failed;
+}
+
+//Scores a long recording with batch mode's chunks and threads, and in one pass, with every detector.
+//Returns the number of detectors whose cards differ.
+static int checkBatch( void ){
+   static const struct { const char * name; const char * detector; bool fixedPoint; } runs[] = {
+      { "fft", "fft", false }, { "yin", "yin", false }, { "multi", "multi", false },
+      { "bank", "bank", false }, { "fixed", "fft", true }
+   };
+   char path[] = "/tmp/tunercheck.XXXXXX";
+   char * paths[1] = { path };
+   int failures = 0;
+   int fd = mkstemp( path );
+   if( fd < 0 ) {
+      perror( path );
+      return 1;
+   }
+   close( fd );
+   if( writeTune( path, SAMPLE_RATE, RECORDING_SECONDS ) ) {
+      unlink( path );
+      return 1;
+   }
+   for( size_t r = 0; r < sizeof( runs ) / sizeof( runs[0] ); ++r ) {
+      struct dinoPitchOptions options;
+      struct analysisOptions analysisOptions;
+      struct scoreCard whole, chunked;
+      bool scored = false;
+      volatile bool running = true;
+      char what[64];
+      snprintf( what, sizeof( what ), "batch against one pass, %s", runs[r].name );
+      defaultDinoPitchOptions( &options );
+      options.sampleRate = SAMPLE_RATE;
+      options.detector = runs[r].detector;
+      options.fixedPoint = runs[r].fixedPoint;
+      int error = analysisOptionsFrom( &options, &analysisOptions );
+      if( error ) fprintf( stderr, "%s: %s\n", what, dinoPitchError( error ) );
+      if( error || scoreWhole( path, &analysisOptions, &whole ) ) {
+         ++failures;
+         continue;
+      }
+      if( scoreRecordings( paths, 1, 0, &options, CHECK_THREADS, &running, &chunked, &scored ) || !scored ) {
+         fprintf( stderr, "%s: not scored\n", what );
+         ++failures;
+      } else {
+         if( whole.numNotes == 0 ) {
+            fprintf( stderr, "%s: no notes were found\n", what );
+            ++failures;
+         }
+         failures += compareCards( what, &whole, &chunked );
+         destroyScoreCard( &chunked );
+      }
+      destroyScoreCard( &whole );
+   }
+   unlink( path );
+   return failures;
+}
+
+//Makes up the n-th frame a session logs: notes of a few frames each, from first on, some a little off
+static struct frameRecord sessionFrame( int n, int64_t first ){
+   struct frameRecord r = {
+      .time = first + n * 64000LL,
+      .centsSharp = ( n * 7 % 31 ) - 15,
+      .level = -1200,
+      .midiNote = 57 + ( n / 9 ) % 12,
+      .channel = ( n == 0 ? FRAME_LOG_FIRST : 0 ) | ( n % 9 == 0 ? FRAME_LOG_ONSET : 0 )
+   };
+   return r;
+}
+
+//Logs a session's frames to path. Returns 0 on success.
+static int logSession( const char * path, int64_t first ){
+   struct frameLog log;
+   if( openFrameLog( &log, path ) ) return 1;
+   for( int n = 0; n < SESSION_FRAMES; ++n ) {
+      struct frameRecord r = sessionFrame( n, first );
+      logFrame( &log, &r );
+   }
+   closeFrameLog( &log );
+   return 0;
+}
+
+//Logs a session, leaves part of a record after it as a crash would, and logs another. Replaying the log
+//must give the two sessions' frames and the card scoring them directly does. Returns 1 if it doesn't.
+static int checkFrameLog( void ){
+   static const unsigned char partial[PARTIAL_BYTES] = { 0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe };
+   char path[] = "/tmp/tunercheck.XXXXXX";
+   struct frameRecord expected[2 * SESSION_FRAMES];
+   int64_t firsts[2] = { 1700000000000000LL, 1700000100000000LL };
+   int failures = 0;
+   int fd = mkstemp( path );
+   if( fd < 0 ) {
+      perror( path );
+      return 1;
+   }
+   close( fd );
+   unlink( path ); //for openFrameLog() to start it
+   if( logSession( path, firsts[0] ) ) return 1;
+   fd = open( path, O_WRONLY | O_APPEND );
+   if( fd < 0 || write( fd, partial, sizeof( partial ) ) != sizeof( partial ) ) {
+      perror( path );
+      if( fd >= 0 ) close( fd );
+      unlink( path );
+      return 1;
+   }
+   close( fd );
+   if( logSession( path, firsts[1] ) ) {
+      unlink( path );
+      return 1;
+   }
+
+   for( int s = 0; s < 2; ++s )
+      for( int n = 0; n < SESSION_FRAMES; ++n )
+         expected[s * SESSION_FRAMES + n] = sessionFrame( n, firsts[s] );
+   struct frameLogMap m;
+   if( mapFrameLog( path, &m ) ) {
+      unlink( path );
+      return 1;
+   }
+   if( m.count != 2 * SESSION_FRAMES ) {
+      fprintf( stderr, "frame log after a crash: %zu records, not the %d logged\n", m.count, 2 * SESSION_FRAMES );
+      failures = 1;
+   } else if( memcmp( m.records, expected, sizeof( expected ) ) ) {
+      fprintf( stderr, "frame log after a crash: the second session's records are out of line\n" );
+      failures = 1;
+   } else {
+      struct scoreCard replayed, direct;
+      struct noteTracker notes;
+      initScoreCard( &replayed );
+      initScoreCard( &direct );
+      initNoteTracker( &notes );
+      replayFrameLog( &m, INT64_MIN, FRAME_LOG_NO_LIMIT, &replayed, &notes, 1 );
+      finishNote( &replayed, &notes );
+      initNoteTracker( &notes );
+      scoreFrames( expected, 2 * SESSION_FRAMES, INT64_MIN, FRAME_LOG_NO_LIMIT, &direct, &notes, 1 );
+      finishNote( &direct, &notes );
+      failures = compareCards( "frame log after a crash", &direct, &replayed );
+      destroyScoreCard( &replayed );
+      destroyScoreCard( &direct );
+   }
+   unmapFrameLog( &m );
+   unlink( path );
+   return failures;
+}
+
+int main( void ){
+   int failures = 0;
+   failures += checkBatch();
+   failures += checkFrameLog();
+   if( failures )
+      printf( "%d check(s) failed\n", failures );
+   else
+      printf( "All checks passed\n" );
+   return failures ? 1 : 0;
+}
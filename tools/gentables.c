@@ -0,0 +1,114 @@
+/* gentables.c - prints the tables in tables.h as C source, for the build
+ *
+ * Run once by the makefile, which compiles what it prints into the
+ * library.  The values are printed as hex floats, so the tables hold
+ * exactly what these loops compute.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "tables.h"
+
+#define Q15_ONE (32767)
+#define Q31_ONE (2147483647.0)
+#define PER_LINE (8)
+
+//Starts a line every PER_LINE values
+static void separate( int i ){
+   printf( i % PER_LINE == PER_LINE - 1 ? ",\n" : ", " );
+}
+
+static void printFloats( const char * declaration, const float * values, int count ){
+   printf( "%s = {\n", declaration );
+   for( int i = 0; i < count; ++i ) {
+      printf( "%af", values[i] );
+      separate( i );
+   }
+   printf( "};\n\n" );
+}
+
+static void printInts( const char * declaration, const long * values, int count ){
+   printf( "%s = {\n", declaration );
+   for( int i = 0; i < count; ++i ) {
+      printf( "%ld", values[i] );
+      separate( i );
+   }
+   printf( "};\n\n" );
+}
+
+//Prints an array of one pointer per size, to the tables called name followed by their size, from
+//2^first points up; smaller sizes get NULL
+static void printPointers( const char * declaration, const char * name, int first ){
+   printf( "%s[LOG2_MAX_TABLE_SIZE + 1] = {\n   ", declaration );
+   for( int b = 0; b <= LOG2_MAX_TABLE_SIZE; ++b ) {
+      if( b < first )
+         printf( "NULL" );
+      else
+         printf( "%s%d", name, 1 << b );
+      printf( b < LOG2_MAX_TABLE_SIZE ? ", " : "\n};\n\n" );
+   }
+}
+
+static float floats[MAX_TABLE_SIZE];
+static long ints[MAX_TABLE_SIZE];
+static long reversed[MAX_TABLE_SIZE];
+
+int main( void ){
+   char declaration[100];
+   printf( "/* tables.c - generated by tools/gentables.c; see tables.h */\n\n" );
+   printf( "#include <stddef.h>\n#include \"tables.h\"\n\n" );
+
+   //each index's reversal is its upper bits' reversal shifted down, with its low bit on top
+   reversed[0] = 0;
+   for( int i = 1; i < MAX_TABLE_SIZE; ++i )
+      reversed[i] = ( reversed[i >> 1] >> 1 ) | ( ( i & 1 ) << ( LOG2_MAX_TABLE_SIZE - 1 ) );
+
+   //each size gets its own bit reversal and twiddles, so every stage of a transform reads them in order;
+   //a 1 point transform has no twiddles, but a 2 point real one runs it, so it has a bit reversal
+   for( int b = 0; b <= LOG2_MAX_TABLE_SIZE; ++b ) {
+      int size = 1 << b;
+      for( int i = 0; i < size; ++i )
+         ints[i] = reversed[i] >> ( LOG2_MAX_TABLE_SIZE - b );
+      sprintf( declaration, "static const uint16_t fftBitReverse%d[%d]", size, size );
+      printInts( declaration, ints, size );
+      if( b == 0 ) continue;
+      for( int i = 0; i < size / 2; ++i )
+         floats[i] = cos( 2 * M_PI * i / size );
+      sprintf( declaration, "static const float fftCos%d[%d]", size, size / 2 );
+      printFloats( declaration, floats, size / 2 );
+      for( int i = 0; i < size / 2; ++i )
+         floats[i] = sin( 2 * M_PI * i / size );
+      sprintf( declaration, "static const float fftSin%d[%d]", size, size / 2 );
+      printFloats( declaration, floats, size / 2 );
+      for( int i = 0; i < size / 2; ++i )
+         ints[i] = lround( Q31_ONE * cos( 2 * M_PI * i / size ) );
+      sprintf( declaration, "static const int32_t fixedFftCos%d[%d]", size, size / 2 );
+      printInts( declaration, ints, size / 2 );
+      for( int i = 0; i < size / 2; ++i )
+         ints[i] = lround( Q31_ONE * sin( 2 * M_PI * i / size ) );
+      sprintf( declaration, "static const int32_t fixedFftSin%d[%d]", size, size / 2 );
+      printInts( declaration, ints, size / 2 );
+   }
+   printPointers( "const uint16_t * const fftBitReverses", "fftBitReverse", 0 );
+   printPointers( "const float * const fftCosines", "fftCos", 1 );
+   printPointers( "const float * const fftSines", "fftSin", 1 );
+   printPointers( "const int32_t * const fixedFftCosines", "fixedFftCos", 1 );
+   printPointers( "const int32_t * const fixedFftSines", "fixedFftSin", 1 );
+
+   //windows to reduce reading of frequencies that are not actually present
+   for( int b = 1; b <= LOG2_MAX_TABLE_SIZE; ++b ) {
+      int size = 1 << b;
+      for( int i = 0; i < size; ++i ) {
+         double w = .5 * ( 1 - cos( 2 * M_PI * i / ( size - 1.0 ) ) );
+         floats[i] = w;
+         ints[i] = lround( Q15_ONE * w );
+      }
+      sprintf( declaration, "static const float hanWindow%d[%d]", size, size );
+      printFloats( declaration, floats, size );
+      sprintf( declaration, "static const int16_t fixedHanWindow%d[%d]", size, size );
+      printInts( declaration, ints, size );
+   }
+   printPointers( "const float * const hanWindows", "hanWindow", 1 );
+   printPointers( "const int16_t * const fixedHanWindows", "fixedHanWindow", 1 );
+   return ferror( stdout ) ? 1 : 0;
+}